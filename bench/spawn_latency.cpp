@@ -0,0 +1,101 @@
+// spawn_latency.cpp
+// Measures how long starting a child takes with fork()+execve() and with posix_spawn() as the
+// parent's resident memory grows, the way cgi::Executor starts CGI scripts.
+//
+// usage: spawn_latency [iterations] [rss-mb ...]   (defaults: 200, 0 256 1024)
+#include <spawn.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+	const char* const kProgram = "/bin/true";
+
+	double now() {
+		timeval tv;
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec * 1e6 + tv.tv_usec;
+	}
+
+	long residentKb() {
+		long pages = 0;
+		long resident = 0;
+		FILE* statm = std::fopen("/proc/self/statm", "r");
+		if (!statm) return -1;
+		if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = -1;
+		std::fclose(statm);
+		return resident * (sysconf(_SC_PAGESIZE) / 1024);
+	}
+
+	pid_t startFork(char* const* argv) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			execve(argv[0], argv, environ);
+			_exit(127);
+		}
+		return pid;
+	}
+
+	pid_t startSpawn(char* const* argv) {
+		pid_t pid = -1;
+		if (posix_spawn(&pid, argv[0], NULL, NULL, argv, environ) != 0) return -1;
+		return pid;
+	}
+
+	// Average microseconds from starting the child to reaping it.
+	double measure(pid_t (*start)(char* const*), int iterations) {
+		char* argv[] = {const_cast<char*>(kProgram), NULL};
+		double begin = now();
+		for (int i = 0; i < iterations; ++i) {
+			pid_t pid = start(argv);
+			if (pid == -1) {
+				std::perror("spawn");
+				std::exit(1);
+			}
+			int status;
+			waitpid(pid, &status, 0);
+		}
+		return (now() - begin) / iterations;
+	}
+}
+
+int main(int argc, char** argv) {
+	int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+	std::vector<size_t> sizes;
+	for (int i = 2; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], NULL, 10));
+	if (sizes.empty()) {
+		sizes.push_back(0);
+		sizes.push_back(256);
+		sizes.push_back(1024);
+	}
+	if (iterations <= 0) iterations = 200;
+
+	std::vector<char*> blocks;
+	size_t held = 0;
+	std::printf("%10s %12s %12s\n", "rss_mb", "fork_us", "spawn_us");
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		// Touched memory stands in for a server's caches and connection buffers.
+		while (held < sizes[i]) {
+			char* block = static_cast<char*>(std::malloc(1024 * 1024));
+			if (!block) {
+				std::perror("malloc");
+				return 1;
+			}
+			std::memset(block, 1, 1024 * 1024);
+			blocks.push_back(block);
+			++held;
+		}
+		double forked = measure(startFork, iterations);
+		double spawned = measure(startSpawn, iterations);
+		std::printf("%10ld %12.1f %12.1f\n", residentKb() / 1024, forked, spawned);
+	}
+	for (size_t i = 0; i < blocks.size(); ++i) std::free(blocks[i]);
+	return 0;
+}
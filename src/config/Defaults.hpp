@@ -10,8 +10,33 @@ namespace config {
 		inline const char* SERVER_NAME() {
 			return "_";
 		}
+		inline const char* CLIENT_BODY_TEMP_PATH() {
+			return "/tmp";
+		}
+		inline const char* CGI_INTERPRETER() {
+			return "/usr/bin/python3";
+		}
 		static const long long CLIENT_MAX_BODY_SIZE = 1024 * 1024;
 		static const long long LIMIT_CLIENT_MAX_BODY_SIZE = 2LL * 1024 * 1024 * 1024;  // 2GB
+		static const long long CLIENT_BODY_BUFFER_SIZE = 16 * 1024;
+		static const int WORKER_PROCESSES = 1;
+		static const int LIMIT_WORKER_PROCESSES = 256;
+		static const int WORKER_THREADS = 1;
+		static const int LIMIT_WORKER_THREADS = 256;
+		static const int WORKER_CONNECTIONS = 1024;
+		static const long CLIENT_HEADER_TIMEOUT = 60 * 1000;  // ms
+		static const long CLIENT_BODY_TIMEOUT = 60 * 1000;
+		static const long KEEPALIVE_TIMEOUT = 75 * 1000;
+		static const long SEND_TIMEOUT = 60 * 1000;
+		static const long KEEPALIVE_REQUESTS = 1000;
+		static const int LISTEN_BACKLOG = 511;
+		static const long CLIENT_READ_SIZE = 64 * 1024;
+		static const long LIMIT_CLIENT_READ_SIZE = 16 * 1024 * 1024;
+		static const int LIMIT_CGI_POOL = 256;
+		static const int CGI_MAX_PROCESSES = 0;  // unlimited
+		static const int LIMIT_CGI_MAX_PROCESSES = 65536;
+		static const long CGI_TIMEOUT = 60 * 1000;
+		static const long CGI_KILL_TIMEOUT = 3 * 1000;
 	}
 }  // namespace config
 
@@ -0,0 +1,51 @@
+// CgiExtensions.cpp
+#include "CgiExtensions.hpp"
+
+using namespace config;
+
+// FNV-1a.
+size_t CgiExtensions::hash(const char* data, size_t length) {
+	size_t value = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		value ^= static_cast<unsigned char>(data[i]);
+		value *= 16777619u;
+	}
+	return value;
+}
+
+// The slot holding the extension, or the empty one where it would go.
+size_t CgiExtensions::slotOf(const char* extension, size_t length) const {
+	size_t slot = hash(extension, length) & (kSlots - 1);
+	while (!_slots[slot].extension.empty()) {
+		const std::string& stored = _slots[slot].extension;
+		if (stored.size() == length && stored.compare(0, length, extension, length) == 0) break;
+		slot = (slot + 1) & (kSlots - 1);
+	}
+	return slot;
+}
+
+// Returns false for an extension already mapped or once the table is full.
+bool CgiExtensions::add(const std::string& extension, const std::string& interpreter) {
+	if (_size == kMaxEntries) return false;
+	Entry& entry = _slots[slotOf(extension.data(), extension.size())];
+	if (!entry.extension.empty()) return false;
+	entry.extension = extension;
+	entry.interpreter = interpreter;
+	++_size;
+	return true;
+}
+
+// The interpreter for a script path, by the extension of its last segment; NULL if unmapped.
+const std::string* CgiExtensions::find(const std::string& path) const {
+	if (_size == 0) return NULL;
+	size_t dot = path.rfind('.');
+	size_t slash = path.rfind('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return NULL;
+
+	const Entry& entry = _slots[slotOf(path.data() + dot, path.size() - dot)];
+	return entry.extension.empty() ? NULL : &entry.interpreter;
+}
+
+bool CgiExtensions::empty() const {
+	return _size == 0;
+}
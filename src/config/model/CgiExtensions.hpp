@@ -0,0 +1,38 @@
+// CgiExtensions.hpp
+#ifndef CONFIG_MODEL_CGI_EXTENSIONS_HPP
+#define CONFIG_MODEL_CGI_EXTENSIONS_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace config {
+	// A location's cgi_ext mappings from script extension to interpreter, filled while the
+	// configuration loads. It is an open-addressing table kept at most half full, so routing a
+	// request hashes the path's extension once and usually compares a single entry.
+	class CgiExtensions {
+		public:
+			static const size_t kSlots = 16;
+			static const size_t kMaxEntries = kSlots / 2;
+
+		private:
+			struct Entry {
+					std::string extension;
+					std::string interpreter;
+			};
+
+			Entry _slots[kSlots];
+			size_t _size;
+
+			static size_t hash(const char*, size_t);
+			size_t slotOf(const char*, size_t) const;
+
+		public:
+			CgiExtensions() : _size(0) {}
+
+			bool add(const std::string&, const std::string&);
+			const std::string* find(const std::string&) const;
+			bool empty() const;
+	};
+}  // namespace config
+
+#endif
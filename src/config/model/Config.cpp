@@ -6,11 +6,28 @@
 
 using namespace config;
 
+LocationConfig::LocationConfig() :
+	_cgi_pool(0),
+	_cgi_timeout(defaults::CGI_TIMEOUT),
+	_cgi_kill_timeout(defaults::CGI_KILL_TIMEOUT),
+	_cgi_cpu_limit(0),
+	_cgi_memory_limit(0) {}
+
 Config::Config() :
 	_server_name(defaults::SERVER_NAME()),
 	_listen(-1),
+	_listen_backlog(defaults::LISTEN_BACKLOG),
 	_auto_index(false),
+	_cgi_request_buffering(true),
 	_client_max_body_size(defaults::CLIENT_MAX_BODY_SIZE),
+	_client_body_buffer_size(defaults::CLIENT_BODY_BUFFER_SIZE),
+	_client_header_timeout(defaults::CLIENT_HEADER_TIMEOUT),
+	_client_body_timeout(defaults::CLIENT_BODY_TIMEOUT),
+	_keepalive_timeout(defaults::KEEPALIVE_TIMEOUT),
+	_send_timeout(defaults::SEND_TIMEOUT),
+	_keepalive_requests(defaults::KEEPALIVE_REQUESTS),
+	_client_read_size(defaults::CLIENT_READ_SIZE),
+	_client_body_temp_path(defaults::CLIENT_BODY_TEMP_PATH()),
 	_index() {}
 
 Config::Config(const Config& other) {
@@ -20,9 +37,19 @@ Config::Config(const Config& other) {
 Config& Config::operator=(const Config& other) {
 	_server_name = other._server_name;
 	_listen = other._listen;
+	_listen_backlog = other._listen_backlog;
 	_auto_index = other._auto_index;
+	_cgi_request_buffering = other._cgi_request_buffering;
 	_client_max_body_size = other._client_max_body_size;
+	_client_body_buffer_size = other._client_body_buffer_size;
+	_client_header_timeout = other._client_header_timeout;
+	_client_body_timeout = other._client_body_timeout;
+	_keepalive_timeout = other._keepalive_timeout;
+	_send_timeout = other._send_timeout;
+	_keepalive_requests = other._keepalive_requests;
+	_client_read_size = other._client_read_size;
 	_upload_path = other._upload_path;
+	_client_body_temp_path = other._client_body_temp_path;
 	_index = other._index;
 	_root = other._root;
 	_location = other._location;
@@ -34,14 +61,54 @@ bool Config::getAutoIndex() const {
 	return _auto_index;
 }
 
+bool Config::getCgiRequestBuffering() const {
+	return _cgi_request_buffering;
+}
+
 int Config::getListen() const {
 	return _listen;
 }
 
+int Config::getListenBacklog() const {
+	return _listen_backlog;
+}
+
 long long Config::getClientMaxBodySize() const {
 	return _client_max_body_size;
 }
 
+long long Config::getClientBodyBufferSize() const {
+	return _client_body_buffer_size;
+}
+
+const std::string& Config::getClientBodyTempPath() const {
+	return _client_body_temp_path;
+}
+
+long Config::getClientHeaderTimeout() const {
+	return _client_header_timeout;
+}
+
+long Config::getClientBodyTimeout() const {
+	return _client_body_timeout;
+}
+
+long Config::getKeepaliveTimeout() const {
+	return _keepalive_timeout;
+}
+
+long Config::getSendTimeout() const {
+	return _send_timeout;
+}
+
+long Config::getKeepaliveRequests() const {
+	return _keepalive_requests;
+}
+
+long Config::getClientReadSize() const {
+	return _client_read_size;
+}
+
 const std::string& Config::getServerName() const {
 	return _server_name;
 }
@@ -70,14 +137,54 @@ void Config::setAutoIndex(bool auto_index) {
 	_auto_index = auto_index;
 }
 
+void Config::setCgiRequestBuffering(bool cgi_request_buffering) {
+	_cgi_request_buffering = cgi_request_buffering;
+}
+
 void Config::setListen(int listen) {
 	_listen = listen;
 }
 
+void Config::setListenBacklog(int listen_backlog) {
+	_listen_backlog = listen_backlog;
+}
+
 void Config::setClientMaxBodySize(long long client_max_body_size) {
 	_client_max_body_size = client_max_body_size;
 }
 
+void Config::setClientBodyBufferSize(long long client_body_buffer_size) {
+	_client_body_buffer_size = client_body_buffer_size;
+}
+
+void Config::setClientBodyTempPath(const std::string& client_body_temp_path) {
+	_client_body_temp_path = client_body_temp_path;
+}
+
+void Config::setClientHeaderTimeout(long client_header_timeout) {
+	_client_header_timeout = client_header_timeout;
+}
+
+void Config::setClientBodyTimeout(long client_body_timeout) {
+	_client_body_timeout = client_body_timeout;
+}
+
+void Config::setKeepaliveTimeout(long keepalive_timeout) {
+	_keepalive_timeout = keepalive_timeout;
+}
+
+void Config::setSendTimeout(long send_timeout) {
+	_send_timeout = send_timeout;
+}
+
+void Config::setKeepaliveRequests(long keepalive_requests) {
+	_keepalive_requests = keepalive_requests;
+}
+
+void Config::setClientReadSize(long client_read_size) {
+	_client_read_size = client_read_size;
+}
+
 void Config::setServerName(const std::string& serverName) {
 	_server_name = serverName;
 }
@@ -120,6 +227,35 @@ void Config::setLocationAllowMethods(const std::string& path,
 	_location[path]._allow_methods = methods;
 }
 
+void Config::setLocationFastcgiPass(const std::string& path, const std::string& socketPath) {
+	_location[path]._fastcgi_pass = socketPath;
+}
+
+void Config::setLocationCgiPool(const std::string& path, int workers) {
+	_location[path]._cgi_pool = workers;
+}
+
+void Config::setLocationCgiTimeout(const std::string& path, long timeout) {
+	_location[path]._cgi_timeout = timeout;
+}
+
+void Config::setLocationCgiKillTimeout(const std::string& path, long timeout) {
+	_location[path]._cgi_kill_timeout = timeout;
+}
+
+void Config::setLocationCgiCpuLimit(const std::string& path, long seconds) {
+	_location[path]._cgi_cpu_limit = seconds;
+}
+
+void Config::setLocationCgiMemoryLimit(const std::string& path, long long bytes) {
+	_location[path]._cgi_memory_limit = bytes;
+}
+
+bool Config::addLocationCgiExt(const std::string& path, const std::string& extension,
+							   const std::string& interpreter) {
+	return _location[path]._cgi_ext.add(extension, interpreter);
+}
+
 const std::string& Config::getLocationRoot(const std::string& path) const {
 	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
 	if (it == _location.end()) {
@@ -143,3 +279,59 @@ const std::vector<std::string>& Config::getLocationAllowMethods(const std::strin
 	}
 	return it->second._allow_methods;
 }
+
+const std::string& Config::getLocationFastcgiPass(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._fastcgi_pass;
+}
+
+int Config::getLocationCgiPool(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._cgi_pool;
+}
+
+long Config::getLocationCgiTimeout(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._cgi_timeout;
+}
+
+long Config::getLocationCgiKillTimeout(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._cgi_kill_timeout;
+}
+
+long Config::getLocationCgiCpuLimit(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._cgi_cpu_limit;
+}
+
+long long Config::getLocationCgiMemoryLimit(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._cgi_memory_limit;
+}
+
+const CgiExtensions& Config::getLocationCgiExt(const std::string& path) const {
+	std::map<std::string, LocationConfig>::const_iterator it = _location.find(path);
+	if (it == _location.end()) {
+		throw Exception("Invalid path: " + path);
+	}
+	return it->second._cgi_ext;
+}
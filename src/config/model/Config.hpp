@@ -6,20 +6,41 @@
 #include <string>
 #include <vector>
 
+#include "CgiExtensions.hpp"
+
 namespace config {
 	struct LocationConfig {
 			std::string _root;
 			std::string _index;
 			std::vector<std::string> _allow_methods;
+			std::string _fastcgi_pass;
+			int _cgi_pool;
+			long _cgi_timeout;
+			long _cgi_kill_timeout;
+			long _cgi_cpu_limit;
+			long long _cgi_memory_limit;
+			CgiExtensions _cgi_ext;
+
+			LocationConfig();
 	};
 
 	class Config {
 		private:
 			std::string _server_name;
 			int _listen;
+			int _listen_backlog;
 			bool _auto_index;
+			bool _cgi_request_buffering;
 			long long _client_max_body_size;
+			long long _client_body_buffer_size;
+			long _client_header_timeout;
+			long _client_body_timeout;
+			long _keepalive_timeout;
+			long _send_timeout;
+			long _keepalive_requests;
+			long _client_read_size;
 			std::string _upload_path;
+			std::string _client_body_temp_path;
 			std::string _index;
 			std::string _root;
 			std::map<std::string, LocationConfig> _location;
@@ -32,8 +53,18 @@ namespace config {
 			~Config() {}
 
 			bool getAutoIndex() const;
+			bool getCgiRequestBuffering() const;
 			int getListen() const;
+			int getListenBacklog() const;
 			long long getClientMaxBodySize() const;
+			long long getClientBodyBufferSize() const;
+			const std::string& getClientBodyTempPath() const;
+			long getClientHeaderTimeout() const;
+			long getClientBodyTimeout() const;
+			long getKeepaliveTimeout() const;
+			long getSendTimeout() const;
+			long getKeepaliveRequests() const;
+			long getClientReadSize() const;
 			const std::string& getServerName() const;
 			const std::string& getIndex() const;
 			const std::string& getUploadPath() const;
@@ -43,10 +74,27 @@ namespace config {
 			const std::string& getLocationRoot(const std::string&) const;
 			const std::string& getLocationIndex(const std::string&) const;
 			const std::vector<std::string>& getLocationAllowMethods(const std::string&) const;
+			const std::string& getLocationFastcgiPass(const std::string&) const;
+			int getLocationCgiPool(const std::string&) const;
+			long getLocationCgiTimeout(const std::string&) const;
+			long getLocationCgiKillTimeout(const std::string&) const;
+			long getLocationCgiCpuLimit(const std::string&) const;
+			long long getLocationCgiMemoryLimit(const std::string&) const;
+			const CgiExtensions& getLocationCgiExt(const std::string&) const;
 
 			void setAutoIndex(bool);
+			void setCgiRequestBuffering(bool);
 			void setListen(int);
+			void setListenBacklog(int);
 			void setClientMaxBodySize(long long);
+			void setClientBodyBufferSize(long long);
+			void setClientBodyTempPath(const std::string&);
+			void setClientHeaderTimeout(long);
+			void setClientBodyTimeout(long);
+			void setKeepaliveTimeout(long);
+			void setSendTimeout(long);
+			void setKeepaliveRequests(long);
+			void setClientReadSize(long);
 			void setServerName(const std::string&);
 			void setUploadPath(const std::string&);
 			void setIndex(const std::string&);
@@ -55,6 +103,13 @@ namespace config {
 			void setLocationRoot(const std::string&, const std::string&);
 			void setLocationIndex(const std::string&, const std::string&);
 			void setLocationAllowMethods(const std::string&, const std::vector<std::string>&);
+			void setLocationFastcgiPass(const std::string&, const std::string&);
+			void setLocationCgiPool(const std::string&, int);
+			void setLocationCgiTimeout(const std::string&, long);
+			void setLocationCgiKillTimeout(const std::string&, long);
+			void setLocationCgiCpuLimit(const std::string&, long);
+			void setLocationCgiMemoryLimit(const std::string&, long long);
+			bool addLocationCgiExt(const std::string&, const std::string&, const std::string&);
 
 			void initLocation(const std::string&);
 	};
@@ -0,0 +1,76 @@
+// HttpConfig.cpp
+#include "HttpConfig.hpp"
+
+#include "../Defaults.hpp"
+
+using namespace config;
+
+HttpConfig::HttpConfig() :
+	_worker_processes(defaults::WORKER_PROCESSES),
+	_worker_threads(defaults::WORKER_THREADS),
+	_worker_connections(defaults::WORKER_CONNECTIONS),
+	_connection_overflow(OverflowEvictIdle),
+	_event_backend(BackendEpoll),
+	_cgi_max_processes(defaults::CGI_MAX_PROCESSES) {}
+
+HttpConfig::HttpConfig(const HttpConfig& other) {
+	*this = other;
+}
+
+HttpConfig& HttpConfig::operator=(const HttpConfig& other) {
+	_worker_processes = other._worker_processes;
+	_worker_threads = other._worker_threads;
+	_worker_connections = other._worker_connections;
+	_connection_overflow = other._connection_overflow;
+	_event_backend = other._event_backend;
+	_cgi_max_processes = other._cgi_max_processes;
+	return *this;
+}
+
+int HttpConfig::getWorkerProcesses() const {
+	return _worker_processes;
+}
+
+int HttpConfig::getWorkerThreads() const {
+	return _worker_threads;
+}
+
+int HttpConfig::getWorkerConnections() const {
+	return _worker_connections;
+}
+
+HttpConfig::ConnectionOverflow HttpConfig::getConnectionOverflow() const {
+	return _connection_overflow;
+}
+
+HttpConfig::EventBackend HttpConfig::getEventBackend() const {
+	return _event_backend;
+}
+
+int HttpConfig::getCgiMaxProcesses() const {
+	return _cgi_max_processes;
+}
+
+void HttpConfig::setWorkerProcesses(int worker_processes) {
+	_worker_processes = worker_processes;
+}
+
+void HttpConfig::setWorkerThreads(int worker_threads) {
+	_worker_threads = worker_threads;
+}
+
+void HttpConfig::setWorkerConnections(int worker_connections) {
+	_worker_connections = worker_connections;
+}
+
+void HttpConfig::setConnectionOverflow(ConnectionOverflow connection_overflow) {
+	_connection_overflow = connection_overflow;
+}
+
+void HttpConfig::setEventBackend(EventBackend event_backend) {
+	_event_backend = event_backend;
+}
+
+void HttpConfig::setCgiMaxProcesses(int cgi_max_processes) {
+	_cgi_max_processes = cgi_max_processes;
+}
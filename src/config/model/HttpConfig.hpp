@@ -0,0 +1,47 @@
+// HttpConfig.hpp
+#ifndef CONFIG_MODEL_HTTPCONFIG_HPP
+#define CONFIG_MODEL_HTTPCONFIG_HPP
+
+namespace config {
+	class HttpConfig {
+		public:
+			enum ConnectionOverflow {
+				OverflowReject,
+				OverflowEvictIdle
+			};
+			enum EventBackend {
+				BackendEpoll,
+				BackendIoUring
+			};
+
+		private:
+			int _worker_processes;
+			int _worker_threads;
+			int _worker_connections;
+			ConnectionOverflow _connection_overflow;
+			EventBackend _event_backend;
+			int _cgi_max_processes;
+
+		public:
+			HttpConfig();
+			HttpConfig(const HttpConfig&);
+			HttpConfig& operator=(const HttpConfig&);
+			~HttpConfig() {}
+
+			int getWorkerProcesses() const;
+			int getWorkerThreads() const;
+			int getWorkerConnections() const;
+			ConnectionOverflow getConnectionOverflow() const;
+			EventBackend getEventBackend() const;
+			int getCgiMaxProcesses() const;
+
+			void setWorkerProcesses(int);
+			void setWorkerThreads(int);
+			void setWorkerConnections(int);
+			void setConnectionOverflow(ConnectionOverflow);
+			void setEventBackend(EventBackend);
+			void setCgiMaxProcesses(int);
+	};
+}  // namespace config
+
+#endif
@@ -1,7 +1,14 @@
 // Parser.cpp
 #include "Parser.hpp"
 
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 #include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <stdexcept>
 
 #include "../../utils/file_utils.hpp"
@@ -60,14 +67,25 @@ void Parser::parseListen(const std::vector<std::string>& tokens, Config& config,
 	else if (port < 0 || 65535 < port)
 		throw Exception("[emerg] Invalid configuration: port range");
 	config.setListen(port);
+
+	while (tokens.at(i + 1) != ";") {
+		const std::string& param = tokens.at(++i);
+		if (param.compare(0, 8, "backlog=") != 0)
+			throw Exception("[emerg] Invalid configuration: listen parameter '" + param + "'");
+		long backlog = std::strtol(param.c_str() + 8, &end, 10);
+		if (*end != 0 || end == param.c_str() + 8 || backlog <= 0 || INT_MAX < backlog)
+			throw Exception("[emerg] Invalid configuration: listen '" + param + "'");
+		config.setListenBacklog(static_cast<int>(backlog));
+	}
 	expectToken(tokens, ++i, ";");
 }
 
-void Parser::parseClientMaxBodySize(const std::vector<std::string>& tokens, Config& config,
-									unsigned long& i) {
+long long Parser::parseSize(const std::string& token, const std::string& directive) const {
 	char* end = NULL;
-	long long size = std::strtoll(tokens.at(i).c_str(), &end, 10);
+	long long size = std::strtoll(token.c_str(), &end, 10);
 
+	if (end == token.c_str())
+		throw Exception("[emerg] Invalid configuration: " + directive + " '" + token + "'");
 	std::string unit(end);
 	for (unsigned long j = 0; j < unit.size(); j++)
 		unit[j] = static_cast<char>(std::tolower(unit[j]));
@@ -78,9 +96,15 @@ void Parser::parseClientMaxBodySize(const std::vector<std::string>& tokens, Conf
 	} else if (unit == "g" || unit == "gb") {
 		size *= 1024 * 1024 * 1024;
 	} else if (!unit.empty()) {
-		throw Exception("[emerg] Invalid configuration: client_max_body_size '" + tokens.at(i) +
-						"'");
+		throw Exception("[emerg] Invalid configuration: " + directive + " '" + token + "'");
 	}
+	return size;
+}
+
+void Parser::parseClientMaxBodySize(const std::vector<std::string>& tokens, Config& config,
+									unsigned long& i) {
+	long long size = parseSize(tokens.at(i), "client_max_body_size");
+
 	if (size < 0 || defaults::LIMIT_CLIENT_MAX_BODY_SIZE < size)
 		throw Exception("[emerg] Invalid configuration: client_max_body_size '" + tokens.at(i) +
 						"'");
@@ -88,6 +112,100 @@ void Parser::parseClientMaxBodySize(const std::vector<std::string>& tokens, Conf
 	expectToken(tokens, ++i, ";");
 }
 
+void Parser::parseClientBodyBufferSize(const std::vector<std::string>& tokens, Config& config,
+									   unsigned long& i) {
+	long long size = parseSize(tokens.at(i), "client_body_buffer_size");
+
+	if (size < 0 || defaults::LIMIT_CLIENT_MAX_BODY_SIZE < size)
+		throw Exception("[emerg] Invalid configuration: client_body_buffer_size '" + tokens.at(i) +
+						"'");
+	config.setClientBodyBufferSize(size);
+	expectToken(tokens, ++i, ";");
+}
+
+// Spooled request bodies are created here, so it must be a directory the server can write to.
+void Parser::parseClientBodyTempPath(const std::vector<std::string>& tokens, Config& config,
+									 unsigned long& i) {
+	const std::string& path = tokens.at(i);
+	struct stat info;
+
+	if (stat(path.c_str(), &info) == -1 || !S_ISDIR(info.st_mode) ||
+		access(path.c_str(), W_OK | X_OK) == -1)
+		throw Exception("[emerg] Invalid configuration: client_body_temp_path '" + path +
+						"' is not a writable directory");
+	config.setClientBodyTempPath(path);
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseClientReadSize(const std::vector<std::string>& tokens, Config& config,
+								 unsigned long& i) {
+	long long size = parseSize(tokens.at(i), "client_read_size");
+
+	if (size <= 0 || defaults::LIMIT_CLIENT_READ_SIZE < size)
+		throw Exception("[emerg] Invalid configuration: client_read_size '" + tokens.at(i) + "'");
+	config.setClientReadSize(static_cast<long>(size));
+	expectToken(tokens, ++i, ";");
+}
+
+// Durations end up as epoll_wait timeouts, so anything past INT_MAX ms (about 24 days) is
+// refused rather than wrapped.
+long Parser::parseDuration(const std::string& token) const {
+	char* end = NULL;
+	errno = 0;
+	long value = std::strtol(token.c_str(), &end, 10);
+	std::string unit(end);
+	long scale = 0;
+
+	if (unit == "ms")
+		scale = 1;
+	else if (unit.empty() || unit == "s")
+		scale = 1000;
+	else if (unit == "m")
+		scale = 60 * 1000;
+	else if (unit == "h")
+		scale = 60 * 60 * 1000;
+	if (end == token.c_str() || errno == ERANGE || value < 0 || scale == 0 ||
+		value > INT_MAX / scale)
+		throw Exception("[emerg] Invalid configuration: time value '" + token + "'");
+	return value * scale;
+}
+
+void Parser::parseClientHeaderTimeout(const std::vector<std::string>& tokens, Config& config,
+									  unsigned long& i) {
+	config.setClientHeaderTimeout(parseDuration(tokens.at(i)));
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseClientBodyTimeout(const std::vector<std::string>& tokens, Config& config,
+									unsigned long& i) {
+	config.setClientBodyTimeout(parseDuration(tokens.at(i)));
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseKeepaliveTimeout(const std::vector<std::string>& tokens, Config& config,
+								   unsigned long& i) {
+	config.setKeepaliveTimeout(parseDuration(tokens.at(i)));
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseSendTimeout(const std::vector<std::string>& tokens, Config& config,
+							  unsigned long& i) {
+	config.setSendTimeout(parseDuration(tokens.at(i)));
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseKeepaliveRequests(const std::vector<std::string>& tokens, Config& config,
+									unsigned long& i) {
+	const std::string& value = tokens.at(i);
+	char* end = NULL;
+	long requests = std::strtol(value.c_str(), &end, 10);
+
+	if (end == value.c_str() || *end != '\0' || requests < 0)
+		throw Exception("[emerg] Invalid configuration: keepalive_requests value '" + value + "'");
+	config.setKeepaliveRequests(requests);
+	expectToken(tokens, ++i, ";");
+}
+
 void Parser::parseAutoIndex(const std::vector<std::string>& tokens, Config& config,
 							unsigned long& i) {
 	std::string status = tokens.at(i);
@@ -100,6 +218,19 @@ void Parser::parseAutoIndex(const std::vector<std::string>& tokens, Config& conf
 	expectToken(tokens, ++i, ";");
 }
 
+void Parser::parseCgiRequestBuffering(const std::vector<std::string>& tokens, Config& config,
+									  unsigned long& i) {
+	std::string status = tokens.at(i);
+	if (status == "on")
+		config.setCgiRequestBuffering(true);
+	else if (status == "off")
+		config.setCgiRequestBuffering(false);
+	else
+		throw Exception("[emerg] Invalid configuration: cgi_request_buffering value '" + status +
+						"'");
+	expectToken(tokens, ++i, ";");
+}
+
 void Parser::parseServerName(const std::vector<std::string>& tokens, Config& config,
 							 unsigned long& i) {
 	config.setServerName(tokens.at(i));
@@ -163,6 +294,81 @@ void Parser::parseLocationAllowMethods(const std::vector<std::string>& tokens, C
 	expectToken(tokens, i, ";");
 }
 
+// Only local backends are supported: fastcgi_pass unix:/path/to/socket;
+void Parser::parseLocationFastcgiPass(const std::vector<std::string>& tokens, Config& config,
+									  const std::string& url, unsigned long& i) {
+	const std::string& address = tokens.at(i);
+	const std::string scheme = "unix:";
+	std::string path = address.compare(0, scheme.size(), scheme) == 0
+						   ? address.substr(scheme.size())
+						   : std::string();
+	if (path.empty() || path.size() >= sizeof(sockaddr_un().sun_path))
+		throw Exception("[emerg] Invalid configuration: fastcgi_pass address '" + address + "'");
+	config.setLocationFastcgiPass(url, path);
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseLocationCgiPool(const std::vector<std::string>& tokens, Config& config,
+								  const std::string& url, unsigned long& i) {
+	const std::string& value = tokens.at(i);
+	char* end = NULL;
+	long workers = std::strtol(value.c_str(), &end, 10);
+
+	if (end == value.c_str() || *end != '\0' || workers < 0 || defaults::LIMIT_CGI_POOL < workers)
+		throw Exception("[emerg] Invalid configuration: cgi_pool value '" + value + "'");
+	config.setLocationCgiPool(url, static_cast<int>(workers));
+	expectToken(tokens, ++i, ";");
+}
+
+// 0 lets a script run for as long as it likes.
+void Parser::parseLocationCgiTimeout(const std::vector<std::string>& tokens, Config& config,
+									 const std::string& url, unsigned long& i) {
+	config.setLocationCgiTimeout(url, parseDuration(tokens.at(i)));
+	expectToken(tokens, ++i, ";");
+}
+
+// How long a script asked to stop with SIGTERM has before SIGKILL; 0 kills it outright.
+void Parser::parseLocationCgiKillTimeout(const std::vector<std::string>& tokens, Config& config,
+										 const std::string& url, unsigned long& i) {
+	config.setLocationCgiKillTimeout(url, parseDuration(tokens.at(i)));
+	expectToken(tokens, ++i, ";");
+}
+
+// RLIMIT_CPU is counted in whole seconds; a shorter limit is rounded up rather than dropped.
+void Parser::parseLocationCgiCpuLimit(const std::vector<std::string>& tokens, Config& config,
+									  const std::string& url, unsigned long& i) {
+	long limit = parseDuration(tokens.at(i));
+	config.setLocationCgiCpuLimit(url, (limit + 999) / 1000);
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseLocationCgiMemoryLimit(const std::vector<std::string>& tokens, Config& config,
+										 const std::string& url, unsigned long& i) {
+	long long size = parseSize(tokens.at(i), "cgi_memory_limit");
+
+	if (size < 0)
+		throw Exception("[emerg] Invalid configuration: cgi_memory_limit '" + tokens.at(i) + "'");
+	config.setLocationCgiMemoryLimit(url, size);
+	expectToken(tokens, ++i, ";");
+}
+
+// cgi_ext .py /usr/bin/python3; The interpreter is run by path, with the script as its argument.
+void Parser::parseLocationCgiExt(const std::vector<std::string>& tokens, Config& config,
+								 const std::string& url, unsigned long& i) {
+	const std::string& extension = tokens.at(i);
+	const std::string& interpreter = tokens.at(++i);
+
+	if (extension.size() < 2 || extension[0] != '.' || extension.find('/') != std::string::npos)
+		throw Exception("[emerg] Invalid configuration: cgi_ext extension '" + extension + "'");
+	if (interpreter.empty() || interpreter[0] != '/')
+		throw Exception("[emerg] Invalid configuration: cgi_ext interpreter '" + interpreter +
+						"'");
+	if (!config.addLocationCgiExt(url, extension, interpreter))
+		throw Exception("[emerg] Invalid configuration: cgi_ext '" + extension +
+						"' duplicated or over the limit");
+	expectToken(tokens, ++i, ";");
+}
+
 void Parser::parseLocation(const std::vector<std::string>& tokens, Config& config,
 						   unsigned long& i) {
 	std::string url = tokens.at(i);
@@ -175,10 +381,116 @@ void Parser::parseLocation(const std::vector<std::string>& tokens, Config& confi
 			parseLocationIndex(tokens, config, url, ++i);
 		else if (tokens.at(i) == "allow_methods")
 			parseLocationAllowMethods(tokens, config, url, ++i);
+		else if (tokens.at(i) == "fastcgi_pass")
+			parseLocationFastcgiPass(tokens, config, url, ++i);
+		else if (tokens.at(i) == "cgi_pool")
+			parseLocationCgiPool(tokens, config, url, ++i);
+		else if (tokens.at(i) == "cgi_timeout")
+			parseLocationCgiTimeout(tokens, config, url, ++i);
+		else if (tokens.at(i) == "cgi_kill_timeout")
+			parseLocationCgiKillTimeout(tokens, config, url, ++i);
+		else if (tokens.at(i) == "cgi_cpu_limit")
+			parseLocationCgiCpuLimit(tokens, config, url, ++i);
+		else if (tokens.at(i) == "cgi_memory_limit")
+			parseLocationCgiMemoryLimit(tokens, config, url, ++i);
+		else if (tokens.at(i) == "cgi_ext")
+			parseLocationCgiExt(tokens, config, url, ++i);
 		else
 			throw Exception("[emerg] Invalid configuration: Unknown directive " + tokens.at(i));
 	}
 	expectToken(tokens, i, "}");
+	// /cgi-bin ran .py scripts with python3 before cgi_ext existed, and still does unless told
+	// otherwise.
+	if ((url == "/cgi-bin" || url == "/cgi-bin/") && config.getLocationCgiExt(url).empty())
+		config.addLocationCgiExt(url, ".py", defaults::CGI_INTERPRETER());
+}
+
+int Parser::parseWorkerCount(const std::vector<std::string>& tokens, const std::string& directive,
+							 long limit, unsigned long& i) {
+	long count;
+	if (tokens.at(i) == "auto") {
+		count = sysconf(_SC_NPROCESSORS_ONLN);
+		if (count < 1) count = 1;
+	} else {
+		char* end = NULL;
+		count = std::strtol(tokens.at(i).c_str(), &end, 10);
+		if (*end != 0 || count < 1)
+			throw Exception("[emerg] Invalid configuration: " + directive + " '" + tokens.at(i) +
+							"'");
+	}
+	if (limit < count) count = limit;
+	expectToken(tokens, ++i, ";");
+	return static_cast<int>(count);
+}
+
+void Parser::parseWorkerProcesses(const std::vector<std::string>& tokens, unsigned long& i) {
+	_httpConfig.setWorkerProcesses(
+		parseWorkerCount(tokens, "worker_processes", defaults::LIMIT_WORKER_PROCESSES, i));
+}
+
+void Parser::parseWorkerThreads(const std::vector<std::string>& tokens, unsigned long& i) {
+	_httpConfig.setWorkerThreads(
+		parseWorkerCount(tokens, "worker_threads", defaults::LIMIT_WORKER_THREADS, i));
+}
+
+void Parser::parseWorkerConnections(const std::vector<std::string>& tokens, unsigned long& i) {
+	char* end = NULL;
+	long count = std::strtol(tokens.at(i).c_str(), &end, 10);
+	if (*end != 0 || count < 1 || 1000000 < count)
+		throw Exception("[emerg] Invalid configuration: worker_connections '" + tokens.at(i) + "'");
+	_httpConfig.setWorkerConnections(static_cast<int>(count));
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseConnectionOverflow(const std::vector<std::string>& tokens, unsigned long& i) {
+	std::string policy = tokens.at(i);
+	if (policy == "reject")
+		_httpConfig.setConnectionOverflow(HttpConfig::OverflowReject);
+	else if (policy == "evict_idle")
+		_httpConfig.setConnectionOverflow(HttpConfig::OverflowEvictIdle);
+	else
+		throw Exception("[emerg] Invalid configuration: connection_overflow value '" + policy +
+						"'");
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseEventBackend(const std::vector<std::string>& tokens, unsigned long& i) {
+	std::string backend = tokens.at(i);
+	if (backend == "epoll")
+		_httpConfig.setEventBackend(HttpConfig::BackendEpoll);
+	else if (backend == "io_uring")
+		_httpConfig.setEventBackend(HttpConfig::BackendIoUring);
+	else
+		throw Exception("[emerg] Invalid configuration: event_backend value '" + backend + "'");
+	expectToken(tokens, ++i, ";");
+}
+
+// Per worker; 0 leaves forked CGI scripts unlimited.
+void Parser::parseCgiMaxProcesses(const std::vector<std::string>& tokens, unsigned long& i) {
+	char* end = NULL;
+	long count = std::strtol(tokens.at(i).c_str(), &end, 10);
+	if (end == tokens.at(i).c_str() || *end != 0 || count < 0 ||
+		defaults::LIMIT_CGI_MAX_PROCESSES < count)
+		throw Exception("[emerg] Invalid configuration: cgi_max_processes '" + tokens.at(i) + "'");
+	_httpConfig.setCgiMaxProcesses(static_cast<int>(count));
+	expectToken(tokens, ++i, ";");
+}
+
+void Parser::parseHttpDirective(const std::vector<std::string>& tokens, unsigned long& i) {
+	if (tokens.at(i) == "worker_processes")
+		parseWorkerProcesses(tokens, ++i);
+	else if (tokens.at(i) == "worker_threads")
+		parseWorkerThreads(tokens, ++i);
+	else if (tokens.at(i) == "worker_connections")
+		parseWorkerConnections(tokens, ++i);
+	else if (tokens.at(i) == "connection_overflow")
+		parseConnectionOverflow(tokens, ++i);
+	else if (tokens.at(i) == "event_backend")
+		parseEventBackend(tokens, ++i);
+	else if (tokens.at(i) == "cgi_max_processes")
+		parseCgiMaxProcesses(tokens, ++i);
+	else
+		throw Exception("[emerg] Invalid configuration: Unknown directive " + tokens.at(i));
 }
 
 Config Parser::parseServer(const std::vector<std::string>& tokens, unsigned long& i) {
@@ -190,8 +502,26 @@ Config Parser::parseServer(const std::vector<std::string>& tokens, unsigned long
 			parseListen(tokens, config, ++i);
 		else if (tokens.at(i) == "client_max_body_size")
 			parseClientMaxBodySize(tokens, config, ++i);
+		else if (tokens.at(i) == "client_body_buffer_size")
+			parseClientBodyBufferSize(tokens, config, ++i);
+		else if (tokens.at(i) == "client_body_temp_path")
+			parseClientBodyTempPath(tokens, config, ++i);
+		else if (tokens.at(i) == "client_read_size")
+			parseClientReadSize(tokens, config, ++i);
+		else if (tokens.at(i) == "client_header_timeout")
+			parseClientHeaderTimeout(tokens, config, ++i);
+		else if (tokens.at(i) == "client_body_timeout")
+			parseClientBodyTimeout(tokens, config, ++i);
+		else if (tokens.at(i) == "keepalive_timeout")
+			parseKeepaliveTimeout(tokens, config, ++i);
+		else if (tokens.at(i) == "send_timeout")
+			parseSendTimeout(tokens, config, ++i);
+		else if (tokens.at(i) == "keepalive_requests")
+			parseKeepaliveRequests(tokens, config, ++i);
 		else if (tokens.at(i) == "autoindex")
 			parseAutoIndex(tokens, config, ++i);
+		else if (tokens.at(i) == "cgi_request_buffering")
+			parseCgiRequestBuffering(tokens, config, ++i);
 		else if (tokens.at(i) == "server_name")
 			parseServerName(tokens, config, ++i);
 		else if (tokens.at(i) == "upload_path")
@@ -217,6 +547,10 @@ void Parser::parse(const std::vector<std::string>& tokens) {
 		expectToken(tokens, i, "http");
 		expectToken(tokens, ++i, "{");
 		while (tokens.at(++i) != "}") {
+			if (tokens.at(i) != "server") {
+				parseHttpDirective(tokens, i);
+				continue;
+			}
 			Config config = parseServer(tokens, i);
 			_configs[config.getListen()] = config;
 		}
@@ -236,3 +570,7 @@ void Parser::loadFromFile(const char* filePath) {
 const std::map<int, Config>& Parser::getConfigs() const {
 	return _configs;
 }
+
+const HttpConfig& Parser::getHttpConfig() const {
+	return _httpConfig;
+}
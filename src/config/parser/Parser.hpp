@@ -6,19 +6,33 @@
 #include <vector>
 
 #include "../model/Config.hpp"
+#include "../model/HttpConfig.hpp"
 
 namespace config {
 	class Parser {
 		private:
 			std::map<int, Config> _configs;
+			HttpConfig _httpConfig;
 
 			std::vector<std::string> tokenize(const std::string&);
 			bool expectToken(const std::vector<std::string>&, unsigned long,
 							 const std::string&) const;
+			long parseDuration(const std::string&) const;
+			long long parseSize(const std::string&, const std::string&) const;
+			void parseClientHeaderTimeout(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseClientBodyTimeout(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseKeepaliveTimeout(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseSendTimeout(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseKeepaliveRequests(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseAutoIndex(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseCgiRequestBuffering(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseErrorPage(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseListen(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseClientMaxBodySize(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseClientBodyBufferSize(const std::vector<std::string>&, Config&,
+										   unsigned long&);
+			void parseClientBodyTempPath(const std::vector<std::string>&, Config&, unsigned long&);
+			void parseClientReadSize(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseServerName(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseUploadPath(const std::vector<std::string>&, Config&, unsigned long&);
 			void parseIndex(const std::vector<std::string>&, Config&, unsigned long&);
@@ -29,7 +43,30 @@ namespace config {
 									unsigned long&);
 			void parseLocationAllowMethods(const std::vector<std::string>&, Config&,
 										   const std::string&, unsigned long&);
+			void parseLocationFastcgiPass(const std::vector<std::string>&, Config&,
+										  const std::string&, unsigned long&);
+			void parseLocationCgiPool(const std::vector<std::string>&, Config&, const std::string&,
+									  unsigned long&);
+			void parseLocationCgiKillTimeout(const std::vector<std::string>&, Config&,
+											 const std::string&, unsigned long&);
+			void parseLocationCgiTimeout(const std::vector<std::string>&, Config&,
+										 const std::string&, unsigned long&);
+			void parseLocationCgiCpuLimit(const std::vector<std::string>&, Config&,
+										  const std::string&, unsigned long&);
+			void parseLocationCgiMemoryLimit(const std::vector<std::string>&, Config&,
+											 const std::string&, unsigned long&);
+			void parseLocationCgiExt(const std::vector<std::string>&, Config&, const std::string&,
+									 unsigned long&);
 			void parseLocation(const std::vector<std::string>&, Config&, unsigned long&);
+			int parseWorkerCount(const std::vector<std::string>&, const std::string&, long,
+								 unsigned long&);
+			void parseWorkerProcesses(const std::vector<std::string>&, unsigned long&);
+			void parseWorkerThreads(const std::vector<std::string>&, unsigned long&);
+			void parseWorkerConnections(const std::vector<std::string>&, unsigned long&);
+			void parseConnectionOverflow(const std::vector<std::string>&, unsigned long&);
+			void parseEventBackend(const std::vector<std::string>&, unsigned long&);
+			void parseCgiMaxProcesses(const std::vector<std::string>&, unsigned long&);
+			void parseHttpDirective(const std::vector<std::string>&, unsigned long&);
 			Config parseServer(const std::vector<std::string>&, unsigned long&);
 			void parse(const std::vector<std::string>&);
 
@@ -40,6 +77,7 @@ namespace config {
 			bool validateArgument(int) const;
 			void loadFromFile(const char*);
 			const std::map<int, Config>& getConfigs() const;
+			const HttpConfig& getHttpConfig() const;
 	};
 }  // namespace config
 
@@ -3,7 +3,11 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
 
 #include "../config/Defaults.hpp"
 #include "../handler/utils/response.hpp"
@@ -11,173 +15,473 @@
 #include "../http/model/Packet.hpp"
 #include "../http/serializer/Serializer.hpp"
 #include "../server/Defaults.hpp"
+#include "../server/timer/TimerWheel.hpp"
+#include "../utils/str_utils.hpp"
 #include "cgi/Executor.hpp"
 #include "cgi/Responder.hpp"
 
 using namespace handler;
 
-EventHandler::EventHandler() {}
+static bool hasToken(const std::string& list, const std::string& token) {
+	std::istringstream iss(list);
+	std::string item;
 
-EventHandler::~EventHandler() {
-	for (std::map<int, http::Parser*>::iterator it = _parsers.begin(); it != _parsers.end(); ++it) {
-		delete it->second;
+	while (std::getline(iss, item, ',')) {
+		size_t first = item.find_first_not_of(" \t");
+		size_t last = item.find_last_not_of(" \t");
+		if (first != std::string::npos && item.substr(first, last - first + 1) == token)
+			return true;
 	}
-	_parsers.clear();
+	return false;
 }
 
-EventHandler::Result EventHandler::handleEvent(int fd, uint32_t events,
-											   const config::Config* config,
-											   server::EpollManager& epollManager) {
-	if (_cgiProcessManager.isCgiProcess(fd)) {
-		return handleCgiEvent(fd, events, config, epollManager);
+EventHandler::EventHandler() : _exitSignalFd(-1) {}
+
+EventHandler::~EventHandler() {}
+
+// Sets up how script exits are noticed, applies cgi_max_processes and starts the cgi_pool
+// workers up front so the first requests do not pay for them.
+void EventHandler::prepareCgi(const config::HttpConfig& httpConfig,
+							  const std::map<int, config::Config>& configs,
+							  server::EpollManager& epollManager) {
+	_exitSignalFd = cgi::Executor::watchExits();
+	if (_exitSignalFd != -1) epollManager.add(_exitSignalFd, EPOLLIN);
+	_cgiProcessManager.setMaxProcesses(static_cast<size_t>(httpConfig.getCgiMaxProcesses()));
+	_workerPool.setMaxProcesses(static_cast<size_t>(httpConfig.getCgiMaxProcesses()));
+	for (std::map<int, config::Config>::const_iterator server = configs.begin();
+		 server != configs.end(); ++server) {
+		const std::map<std::string, config::LocationConfig>& locations =
+			server->second.getLocation();
+		for (std::map<std::string, config::LocationConfig>::const_iterator it = locations.begin();
+			 it != locations.end(); ++it) {
+			const config::LocationConfig& location = it->second;
+			const std::string* python = location._cgi_ext.find(".py");
+			if (location._cgi_pool <= 0 || !location._fastcgi_pass.empty() || !python) continue;
+			if (cgi::WorkerPool::runs(*python))
+				_workerPool.warm(location._root, location._cgi_pool, *python, epollManager);
+			else if (cgi::WorkerPool::bootstrap().empty())
+				std::cerr << "[Warn] cgi_pool: pool_worker.py is not installed next to the binary, "
+						  << it->first << " starts a process per request" << std::endl;
+		}
 	}
-	return handleClientEvent(fd, events, config, epollManager);
+}
+
+cgi::IBackend& EventHandler::backendOf(int clientFd) {
+	if (_fastCgiClient.isProcessing(clientFd)) return _fastCgiClient;
+	if (_workerPool.isProcessing(clientFd)) return _workerPool;
+	return _cgiProcessManager;
 }
 
 EventHandler::Result EventHandler::handleCgiEvent(int fd, uint32_t events,
-												  const config::Config* config,
+												  server::Connection& client,
 												  server::EpollManager& epollManager) {
+	_cgiProcessManager.handleCgiEvent(fd, events, epollManager);
+	return resumeCgi(client, epollManager);
+}
+
+// FastCGI connections, pool workers and scripts' pidfds outlive the requests they serve; the
+// clients whose requests moved are collected for the caller to resume.
+void EventHandler::handleCgiConnectionEvent(int fd, uint32_t events,
+											server::EpollManager& epollManager,
+											std::vector<int>& clients) {
+	if (fd == _exitSignalFd)
+		cgi::Executor::collectExits(fd);
+	else if (_cgiProcessManager.isChild(fd))
+		_cgiProcessManager.reap(fd, epollManager, clients);
+	else if (_fastCgiClient.isConnection(fd))
+		_fastCgiClient.handleEvent(fd, events, epollManager, clients);
+	else
+		_workerPool.handleEvent(fd, events, epollManager, clients);
+}
+
+EventHandler::Result EventHandler::resumeCgi(server::Connection& client,
+											 server::EpollManager& epollManager) {
 	Result result;
-	int clientFd = _cgiProcessManager.getClientFd(fd);
-	if (clientFd == -1) return result;
+	if (client.streamingBody) pumpBody(client, epollManager, result);
+	relayOutput(client, epollManager, result);
+	return result;
+}
 
-	_cgiProcessManager.handleCgiEvent(fd, events, epollManager);
-	if (!_cgiProcessManager.isCompleted(clientFd)) return result;
+// Forwards what the script has written so far: the response head once its header block is
+// complete, then body pieces framed as the head announced. The piece after the script's last
+// byte decides whether the connection stays open.
+void EventHandler::relayOutput(server::Connection& client, server::EpollManager& epollManager,
+							   Result& result) {
+	cgi::IBackend& backend = backendOf(client.fd);
+	cgi::Responder::Relay* relay = backend.relayOf(client.fd);
+	if (!relay || relay->framing == cgi::Responder::Relay::Spliced) return;
+	bool completed = backend.isCompleted(client.fd);
 
-	std::map<int, const config::Config*>::const_iterator it = _cgiClientConfigs.find(clientFd);
-	if (it != _cgiClientConfigs.end()) config = it->second;
+	// The script answered without reading all of its body; the rest cannot be told apart from
+	// a following request, so the connection ends with this response.
+	if (completed && client.streamingBody) {
+		client.streamingBody = false;
+		client.inputPaused = false;
+		client.cgiKeepAlive = false;
+		client.parser.reset();
+	}
 
-	std::string rawResponse;
 	try {
-		std::string cgiOutput = _cgiProcessManager.getResponse(fd);
-		rawResponse =
-			config ? cgi::Responder::makeCgiResponse(cgiOutput)
-				   : http::Serializer::serialize(
-						 utils::makeErrorResponse(http::StatusCode::InternalServerError, config));
+		std::string head;
+		if (relay->framing == cgi::Responder::Relay::Head) {
+			if (!client.config) throw handler::Exception();
+			if (!cgi::Responder::makeHead(*relay, client.cgiKeepAlive, head)) {
+				if (!completed) return;
+				throw handler::Exception();
+			}
+		}
+		result.responses.push_back(Response(client.fd));
+		Response& piece = result.responses.back();
+		cgi::Responder::takeBody(*relay, piece.data, piece.body);
+		piece.data.insert(0, head);
+
+		// The rest of a body of known length is left to the output queue, which moves it from
+		// the script's socket to the client's with splice().
+		if (!completed && relay->framing == cgi::Responder::Relay::Length && relay->remaining > 0 &&
+			backend.canSplice() && client.output.openRelay()) {
+			piece.relayFd = backend.spliceOutput(client.fd);
+			piece.relayLength = static_cast<size_t>(relay->remaining);
+			relay->framing = cgi::Responder::Relay::Spliced;
+			return;
+		}
 	} catch (const handler::Exception&) {
-		rawResponse = http::Serializer::serialize(
-			utils::makeErrorResponse(http::StatusCode::InternalServerError, config));
+		// No usable head: a script that crashed or exited non-zero is a bad gateway.
+		http::Packet errorPacket = utils::makeErrorResponse(
+			relay->failed ? http::StatusCode::BadGateway : http::StatusCode::InternalServerError,
+			client.config);
+		addResponse(result, client.fd, errorPacket, !client.cgiKeepAlive);
+		completed = true;
+	}
+	if (completed) finishCgi(client, epollManager, result);
+}
+
+void EventHandler::finishCgi(server::Connection& client, server::EpollManager& epollManager,
+							 Result& result) {
+	cgi::IBackend& backend = backendOf(client.fd);
+	cgi::Responder::Relay* relay = backend.relayOf(client.fd);
+	if (relay && relay->framing != cgi::Responder::Relay::Head) {
+		std::string tail = cgi::Responder::finish(*relay, client.cgiKeepAlive);
+		result.responses.push_back(Response(client.fd, tail, !client.cgiKeepAlive));
 	}
-	_cgiProcessManager.removeCgiProcess(clientFd, epollManager);
-	_cgiClientConfigs.erase(clientFd);
-	result.response = Response(clientFd, rawResponse, true);
+	backend.release(client.fd, epollManager);
+	client.cgiPending = false;
+	client.cgiDeadline = 0;
+
+	if (client.cgiKeepAlive) processRequests(client, epollManager, result);
+}
+
+// Called whenever the client's output has moved. A copied relay stops reading the script while
+// the client is behind; a spliced one polls the script only while it is waiting on it, and
+// finishes the request once the queue has sent the last byte.
+EventHandler::Result EventHandler::handleOutputProgress(server::Connection& client,
+														server::EpollManager& epollManager) {
+	Result result;
+	cgi::IBackend& backend = backendOf(client.fd);
+	cgi::Responder::Relay* relay = backend.relayOf(client.fd);
+	if (!relay) return result;
+
+	bool spliced = relay->framing == cgi::Responder::Relay::Spliced;
+	if (spliced && !client.output.relaying()) {
+		finishCgi(client, epollManager, result);
+		return result;
+	}
+	bool paused = spliced ? !client.output.waiting() : client.readPaused;
+	backend.pauseOutput(client.fd, paused, epollManager);
 	return result;
 }
 
-EventHandler::Result EventHandler::handleClientEvent(int fd, uint32_t events,
-													 const config::Config* config,
-													 server::EpollManager& epollManager) {
+EventHandler::Result EventHandler::handleEvent(server::Connection& client, uint32_t events,
+											   server::EpollManager& epollManager) {
+	size_t received = 0;
+	bool open = readSocket(client, received);
+	bool disconnected = !open || (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+	return handleInput(client, received, disconnected, epollManager);
+}
+
+// Bytes an io_uring recv has already taken off the socket; none means the peer is gone.
+EventHandler::Result EventHandler::handleReceived(server::Connection& client, const char* data,
+												  size_t length,
+												  server::EpollManager& epollManager) {
+	for (size_t copied = 0; copied < length;) {
+		size_t available = 0;
+		char* buffer = client.parser.writable(server::defaults::READ_CHUNK_SIZE, available);
+		size_t chunk = std::min(available, length - copied);
+		std::memcpy(buffer, data + copied, chunk);
+		client.parser.commit(chunk);
+		copied += chunk;
+	}
+	return handleInput(client, length, length == 0, epollManager);
+}
+
+EventHandler::Result EventHandler::handleInput(server::Connection& client, size_t received,
+											   bool disconnected,
+											   server::EpollManager& epollManager) {
 	Result result;
-	bool disconnected = (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
-	std::string buffer = readSocket(fd);
-	http::Parser* parser = ensureParser(fd, config);
-
-	if (!buffer.empty()) parser->append(buffer);
-	if (disconnected) parser->markEndOfInput();
-	if (buffer.empty() && !disconnected) return result;
-
-	while (true) {
-		http::Parser::Result parseResult = parser->parse();
-		switch (parseResult.status) {
-			case http::Parser::Result::Incomplete:
-				break;
-			case http::Parser::Result::Error: {
-				const bool hasMessage = !parseResult.errorMessage.empty();
-				const std::string& fallbackBody = parseResult.errorMessage;
-				const std::string fallbackContentType =
-					hasMessage ? http::ContentType::to_string(http::ContentType::CONTENT_TEXT_PLAIN)
-							   : std::string();
-				http::Packet errorPacket =
-					utils::makeErrorResponse(parseResult.errorCode, config, fallbackBody,
-											 fallbackContentType);
-				result.response = Response(fd, http::Serializer::serialize(errorPacket), true);
-				break;
-			}
-			case http::Parser::Result::Completed: {
-				if (!config) {
-					http::Packet errorPacket =
-						utils::makeErrorResponse(http::StatusCode::InternalServerError, config);
-					result.response = Response(fd, http::Serializer::serialize(errorPacket), true);
-					break;
-				}
-
-				http::Packet httpRequest = parseResult.packet;
-				std::string remainder = parseResult.leftover;
-				bool ended = parseResult.endOfInput;
-
-				router::RouteDecision decision = _router.route(httpRequest, *config);
-				if (decision.action == router::RouteDecision::Cgi) {
-					_cgiClientConfigs[fd] = decision.server;
-					cgi::Executor executor;
-					executor.execute(decision, httpRequest, epollManager, _cgiProcessManager, fd);
-
-					if (ended) result.closeFd = fd;
-					if (!remainder.empty()) {
-						parser->append(remainder);
-						if (ended) parser->markEndOfInput();
-						if (!ended) continue;
-					}
-					break;
-				}
-
-				http::Packet httpResponse =
-					_requestHandler.handle(fd, httpRequest, decision, *config);
-				result.response = Response(fd, http::Serializer::serialize(httpResponse), ended);
-
-				if (!remainder.empty()) {
-					parser->append(remainder);
-					if (ended) parser->markEndOfInput();
-					if (!ended) continue;
-				}
-				if (ended) result.closeFd = fd;
-				break;
-			}
-		}
-		break;
+	if (disconnected) {
+		client.parser.markEndOfInput();
+		client.cgiKeepAlive = false;
+	}
+	if (received == 0 && !disconnected) {
+		client.parser.releaseIdleBuffer();
+		return result;
 	}
 
-	if (disconnected) result.closeFd = fd;
+	// Pipelined requests wait behind an in-flight CGI so responses stay in order.
+	if (!client.cgiPending)
+		processRequests(client, epollManager, result);
+	else if (client.streamingBody)
+		pumpBody(client, epollManager, result);
+	if (disconnected) result.closeFd = client.fd;
 	return result;
 }
 
-void EventHandler::cleanup(int fd, server::EpollManager& epollManager) {
-	std::map<int, http::Parser*>::iterator it = _parsers.find(fd);
-	if (it != _parsers.end()) {
-		delete it->second;
-		_parsers.erase(it);
+void EventHandler::processRequests(server::Connection& client, server::EpollManager& epollManager,
+								   Result& result) {
+	http::Parser& parser = client.parser;
+	const config::Config* config = client.config;
+
+	while (parser.hasPendingInput()) {
+		http::Parser::Result parseResult = parser.parse();
+		if (parseResult.status == http::Parser::Result::Incomplete) return;
+		if (parseResult.status == http::Parser::Result::Error) {
+			const bool hasMessage = !parseResult.errorMessage.empty();
+			const std::string& fallbackBody = parseResult.errorMessage;
+			const std::string fallbackContentType =
+				hasMessage ? http::ContentType::to_string(http::ContentType::CONTENT_TEXT_PLAIN)
+						   : std::string();
+			http::Packet errorPacket = utils::makeErrorResponse(parseResult.errorCode, config,
+																fallbackBody, fallbackContentType);
+			addResponse(result, client.fd, errorPacket, true);
+			return;
+		}
+		if (!config) {
+			http::Packet errorPacket =
+				utils::makeErrorResponse(http::StatusCode::InternalServerError, config);
+			addResponse(result, client.fd, errorPacket, true);
+			return;
+		}
+		if (parseResult.status == http::Parser::Result::HeadReady) {
+			if (!streamToCgi(client, epollManager, result)) continue;
+			return;
+		}
+
+		http::Packet& httpRequest = parseResult.packet;
+		bool ended = parseResult.endOfInput;
+		bool persist = keepAlive(client, httpRequest) && !(ended && !parser.hasPendingInput());
+		if (!persist) parser.reset();
+
+		router::RouteDecision decision = _router.route(httpRequest, *config);
+		if (decision.action == router::RouteDecision::Cgi) {
+			client.cgiKeepAlive = persist;
+			if (startCgi(client, decision, httpRequest, false, epollManager)) return;
+			decision.action = router::RouteDecision::Error;
+			decision.status = http::StatusCode::BadGateway;
+		}
+
+		http::Packet httpResponse =
+			_requestHandler.handle(client.fd, httpRequest, decision, *config);
+		addResponse(result, client.fd, httpResponse, !persist);
+		if (!persist) return;
+	}
+}
+
+// Returns false when the script cannot be started or its FastCGI backend cannot be reached.
+// A script whose worker pool has no worker running is started on its own instead.
+bool EventHandler::startCgi(server::Connection& client, const router::RouteDecision& decision,
+							const http::Packet& request, bool streamBody,
+							server::EpollManager& epollManager) {
+	bool pooled = decision.fastcgiPass.empty() && decision.cgiPool > 0 &&
+				  cgi::WorkerPool::runs(decision.cgiInterpreter) &&
+				  _workerPool.start(decision, request, client.peer, client.fd, streamBody,
+									epollManager);
+	if (!decision.fastcgiPass.empty()) {
+		if (!_fastCgiClient.start(decision, request, client.peer, client.fd, streamBody,
+								  epollManager))
+			return false;
+	} else if (!pooled) {
+		cgi::Executor executor;
+		if (!executor.execute(decision, request, client.peer, epollManager, _cgiProcessManager,
+							  client.fd, streamBody))
+			return false;
+	}
+	client.cgiPending = true;
+	client.cgiDeadline =
+		decision.cgiTimeout > 0 ? server::TimerWheel::now() + decision.cgiTimeout : 0;
+	cgi::Responder::Relay* relay = backendOf(client.fd).relayOf(client.fd);
+	if (relay) relay->allowChunked = request.getStartLine().version != "HTTP/1.0";
+	return true;
+}
+
+// With cgi_request_buffering off, a request routed to CGI starts its script as soon as the head
+// is in, and the body is pumped into stdin as it arrives. Other routes buffer the body as usual.
+bool EventHandler::streamToCgi(server::Connection& client, server::EpollManager& epollManager,
+							   Result& result) {
+	const http::Packet& head = client.parser.head();
+	router::RouteDecision decision = _router.route(head, *client.config);
+	if (decision.action != router::RouteDecision::Cgi) return false;
+
+	client.parser.streamBody();
+	client.cgiKeepAlive = keepAlive(client, head);
+	if (!startCgi(client, decision, head, true, epollManager)) {
+		client.parser.reset();
+		http::Packet errorPacket =
+			utils::makeErrorResponse(http::StatusCode::BadGateway, client.config);
+		addResponse(result, client.fd, errorPacket, true);
+		return true;
 	}
-	_cgiClientConfigs.erase(fd);
-	_cgiProcessManager.removeCgiProcess(fd, epollManager);
-}
-
-http::Parser* EventHandler::ensureParser(int fd, const config::Config* config) {
-	std::map<int, http::Parser*>::iterator it = _parsers.find(fd);
-	if (it == _parsers.end()) {
-		http::Parser* parser = new http::Parser();
-		size_t maxBodySize = static_cast<size_t>(config ? config->getClientMaxBodySize()
-														: config::defaults::CLIENT_MAX_BODY_SIZE);
-		parser->setMaxBodySize(maxBodySize);
-		_parsers.insert(std::make_pair(fd, parser));
-		return parser;
+	client.streamingBody = true;
+	pumpBody(client, epollManager, result);
+	return true;
+}
+
+// Moves body bytes from the receive buffer into the script's stdin until either side runs dry.
+// Reading from the client pauses while the script is not keeping up and more than
+// client_body_buffer_size is waiting, and resumes from the stdin EPOLLOUT that drains it.
+void EventHandler::pumpBody(server::Connection& client, server::EpollManager& epollManager,
+							Result& result) {
+	http::Parser& parser = client.parser;
+	bool blocked = false;
+
+	while (!blocked) {
+		http::Parser::Result parseResult = parser.parse();
+		if (parseResult.status == http::Parser::Result::Error) {
+			stopStream(client, epollManager);
+			http::Packet errorPacket = utils::makeErrorResponse(parseResult.errorCode, client.config);
+			addResponse(result, client.fd, errorPacket, true);
+			return;
+		}
+		if (parseResult.status == http::Parser::Result::Completed) {
+			backendOf(client.fd).finishInput(client.fd, epollManager);
+			client.streamingBody = false;
+			client.inputPaused = false;
+			if (parseResult.endOfInput && !parser.hasPendingInput()) client.cgiKeepAlive = false;
+			if (!client.cgiKeepAlive) parser.reset();
+			return;
+		}
+
+		const char* data = NULL;
+		size_t available = parser.bodyAvailable(data);
+		if (available == 0) break;
+		size_t written = backendOf(client.fd).writeInput(client.fd, data, available, epollManager);
+		parser.consumeBody(written);
+		blocked = written < available;
 	}
-	return it->second;
+	client.inputPaused =
+		blocked &&
+		parser.buffered() > static_cast<size_t>(client.config->getClientBodyBufferSize());
+}
+
+void EventHandler::stopStream(server::Connection& client, server::EpollManager& epollManager) {
+	if (client.output.relaying()) client.output.clear();
+	backendOf(client.fd).release(client.fd, epollManager);
+	client.cgiPending = false;
+	client.cgiDeadline = 0;
+	client.streamingBody = false;
+	client.inputPaused = false;
+}
+
+bool EventHandler::keepAlive(server::Connection& client, const http::Packet& request) {
+	const config::Config& config = *client.config;
+	long served = ++client.requests;
+	if (config.getKeepaliveTimeout() == 0 || served >= config.getKeepaliveRequests()) return false;
+
+	const std::string connection = to_lower(request.getHeader().get("Connection"));
+	if (hasToken(connection, "close")) return false;
+	if (request.getStartLine().version == "HTTP/1.0") return hasToken(connection, "keep-alive");
+	return true;
+}
+
+EventHandler::Result EventHandler::handleTimeout(server::Connection& client) {
+	Result result;
+	http::Packet errorPacket =
+		utils::makeErrorResponse(http::StatusCode::RequestTimeout, client.config);
+	addResponse(result, client.fd, errorPacket, true);
+	return result;
+}
+
+// cgi_timeout ran out: the script is dropped, which stops it, and the client gets 504 if no
+// part of the response has gone out yet. Either way the connection is closed.
+EventHandler::Result EventHandler::handleCgiTimeout(server::Connection& client,
+													server::EpollManager& epollManager) {
+	Result result;
+	cgi::Responder::Relay* relay = backendOf(client.fd).relayOf(client.fd);
+	bool started = relay && relay->framing != cgi::Responder::Relay::Head;
+
+	stopStream(client, epollManager);
+	client.parser.reset();
+	if (!started) {
+		http::Packet errorPacket =
+			utils::makeErrorResponse(http::StatusCode::GatewayTimeout, client.config);
+		addResponse(result, client.fd, errorPacket, true);
+	}
+	result.closeFd = client.fd;
+	return result;
+}
+
+int EventHandler::nextCgiTimeout(unsigned long long now) const {
+	return _cgiProcessManager.nextTimeout(now);
+}
+
+void EventHandler::expireCgi(unsigned long long now) {
+	_cgiProcessManager.expire(now);
+}
+
+void EventHandler::cleanup(server::Connection& client, server::EpollManager& epollManager) {
+	stopStream(client, epollManager);
+	client.parser.reset();
+}
+
+void EventHandler::addResponse(Result& result, int fd, http::Packet& packet,
+							   bool closeAfterSend) const {
+	packet.addHeader("Connection", closeAfterSend ? "close" : "keep-alive");
+	result.responses.push_back(Response(fd, http::Serializer::serializeHead(packet), closeAfterSend));
+	Response& response = result.responses.back();
+	packet.releaseBody(response.body);
+	response.file = packet.getBody().getFile();
+}
+
+int EventHandler::cgiClientOf(int fd) const {
+	return _cgiProcessManager.getClientFd(fd);
+}
+
+bool EventHandler::isCgiConnection(int fd) const {
+	return fd == _exitSignalFd || _cgiProcessManager.isChild(fd) ||
+		   _fastCgiClient.isConnection(fd) || _workerPool.isWorker(fd);
+}
+
+bool EventHandler::isIdle(const server::Connection& client) const {
+	return !client.cgiPending && !client.parser.hasPendingInput();
+}
+
+bool EventHandler::isReadingBody(const server::Connection& client) const {
+	return client.parser.inBody();
+}
+
+bool EventHandler::isWaitingCgi(const server::Connection& client) const {
+	return client.cgiPending;
 }
 
-std::string EventHandler::readSocket(int socketFd) const {
-	char buffer[server::defaults::BUFFER_SIZE] = {0};
-	std::string request;
+// Reads until the socket would block or the server's per-event read budget is spent, straight
+// into the parser's buffer. Returns false once the peer has closed or the socket failed.
+bool EventHandler::readSocket(server::Connection& client, size_t& received) const {
+	const size_t budget = static_cast<size_t>(
+		client.config ? client.config->getClientReadSize() : config::defaults::CLIENT_READ_SIZE);
 
-	while (true) {
-		ssize_t readSize = ::read(socketFd, buffer, server::defaults::BUFFER_SIZE);
+	received = 0;
+	while (received < budget) {
+		size_t available = 0;
+		char* buffer = client.parser.writable(server::defaults::READ_CHUNK_SIZE, available);
+		ssize_t readSize = ::read(client.fd, buffer, std::min(available, budget - received));
 		if (readSize > 0) {
-			request.append(buffer, readSize);
-			if (readSize < server::defaults::BUFFER_SIZE) break;
+			client.parser.commit(static_cast<size_t>(readSize));
+			received += static_cast<size_t>(readSize);
 		} else if (readSize == 0) {
-			break;
+			return false;
+		} else if (errno == EINTR) {
+			continue;
 		} else {
-			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-			return std::string();
+			return errno == EAGAIN || errno == EWOULDBLOCK;
 		}
 	}
-	return request;
+	return true;
 }
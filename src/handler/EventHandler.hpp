@@ -3,14 +3,20 @@
 #define HANDLER_EVENTHANDLER_HPP
 
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "../config/model/Config.hpp"
+#include "../config/model/HttpConfig.hpp"
 #include "../http/parser/Parser.hpp"
 #include "../router/Router.hpp"
+#include "../server/connection/Connection.hpp"
 #include "RequestHandler.hpp"
+#include "cgi/FastCgiClient.hpp"
 #include "cgi/ProcessManager.hpp"
+#include "cgi/WorkerPool.hpp"
 
 namespace server {
 	class EpollManager;
@@ -22,35 +28,69 @@ namespace handler {
 			struct Response {
 					int fd;
 					std::string data;
+					std::vector<unsigned char> body;
+					http::FileRegion file;
+					int relayFd;
+					size_t relayLength;
 					bool closeAfterSend;
 					explicit Response(int socket = -1, const std::string& raw = std::string(),
 									  bool close = false) :
-						fd(socket), data(raw), closeAfterSend(close) {}
+						fd(socket),
+						data(raw),
+						relayFd(-1),
+						relayLength(0),
+						closeAfterSend(close) {}
 			};
 			struct Result {
-					Response response;
+					std::deque<Response> responses;
 					int closeFd;
-					Result() : response(), closeFd(-1) {}
+					Result() : closeFd(-1) {}
 			};
 
 		private:
 			router::Router _router;
 			RequestHandler _requestHandler;
 			cgi::ProcessManager _cgiProcessManager;
-			std::map<int, http::Parser*> _parsers;
-			std::map<int, const config::Config*> _cgiClientConfigs;
+			cgi::FastCgiClient _fastCgiClient;
+			cgi::WorkerPool _workerPool;
+			int _exitSignalFd;
 
-			http::Parser* ensureParser(int, const config::Config*);
-			std::string readSocket(int) const;
-			Result handleClientEvent(int, uint32_t, const config::Config*, server::EpollManager&);
-			Result handleCgiEvent(int, uint32_t, const config::Config*, server::EpollManager&);
+			cgi::IBackend& backendOf(int);
+			void addResponse(Result&, int, http::Packet&, bool) const;
+			bool keepAlive(server::Connection&, const http::Packet&);
+			void processRequests(server::Connection&, server::EpollManager&, Result&);
+			bool startCgi(server::Connection&, const router::RouteDecision&, const http::Packet&,
+						  bool, server::EpollManager&);
+			bool streamToCgi(server::Connection&, server::EpollManager&, Result&);
+			void pumpBody(server::Connection&, server::EpollManager&, Result&);
+			void stopStream(server::Connection&, server::EpollManager&);
+			void relayOutput(server::Connection&, server::EpollManager&, Result&);
+			void finishCgi(server::Connection&, server::EpollManager&, Result&);
+			bool readSocket(server::Connection&, size_t&) const;
+			Result handleInput(server::Connection&, size_t, bool, server::EpollManager&);
 
 		public:
 			EventHandler();
 			~EventHandler();
 
-			Result handleEvent(int, uint32_t, const config::Config*, server::EpollManager&);
-			void cleanup(int, server::EpollManager&);
+			void prepareCgi(const config::HttpConfig&, const std::map<int, config::Config>&,
+							server::EpollManager&);
+			Result handleEvent(server::Connection&, uint32_t, server::EpollManager&);
+			Result handleReceived(server::Connection&, const char*, size_t, server::EpollManager&);
+			Result handleCgiEvent(int, uint32_t, server::Connection&, server::EpollManager&);
+			void handleCgiConnectionEvent(int, uint32_t, server::EpollManager&, std::vector<int>&);
+			Result resumeCgi(server::Connection&, server::EpollManager&);
+			Result handleTimeout(server::Connection&);
+			Result handleCgiTimeout(server::Connection&, server::EpollManager&);
+			int nextCgiTimeout(unsigned long long) const;
+			void expireCgi(unsigned long long);
+			Result handleOutputProgress(server::Connection&, server::EpollManager&);
+			void cleanup(server::Connection&, server::EpollManager&);
+			int cgiClientOf(int) const;
+			bool isCgiConnection(int) const;
+			bool isIdle(const server::Connection&) const;
+			bool isReadingBody(const server::Connection&) const;
+			bool isWaitingCgi(const server::Connection&) const;
 	};
 }  // namespace handler
 
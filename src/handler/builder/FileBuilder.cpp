@@ -1,14 +1,30 @@
 // FileBuilder.cpp
 #include "FileBuilder.hpp"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "../utils/response.hpp"
 
 using namespace handler::builder;
 
+http::FileRegion FileBuilder::openFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return http::FileRegion();
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return http::FileRegion();
+	}
+	return http::FileRegion(fd, 0, static_cast<size_t>(st.st_size));
+}
+
 http::Packet FileBuilder::build(const router::RouteDecision& decision, const http::Packet&,
 								const config::Config& config) const {
-	std::string fileData;
-	if (!utils::loadPageContent(decision.fsPath, fileData)) {
+	http::FileRegion file = openFile(decision.fsPath);
+	if (!file.isOpen()) {
 		return utils::makeErrorResponse(
 			http::StatusCode::NotFound, &config,
 			http::StatusCode::to_reasonPhrase(http::StatusCode::NotFound),
@@ -21,6 +37,6 @@ http::Packet FileBuilder::build(const router::RouteDecision& decision, const htt
 
 	response.addHeader("Content-Type", decision.contentTypeHint.empty() ? "application/octet-stream"
 																		: decision.contentTypeHint);
-	if (!fileData.empty()) response.appendBody(fileData.data(), fileData.size());
+	if (file.getLength() > 0) response.attachBodyFile(file);
 	return response;
 }
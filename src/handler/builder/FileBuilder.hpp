@@ -7,6 +7,9 @@
 namespace handler {
 	namespace builder {
 		class FileBuilder : public IBuilder {
+			private:
+				static http::FileRegion openFile(const std::string&);
+
 			public:
 				virtual http::Packet build(const router::RouteDecision&, const http::Packet&,
 										   const config::Config&) const;
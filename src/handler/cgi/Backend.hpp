@@ -0,0 +1,30 @@
+// Backend.hpp
+#ifndef HANDLER_CGI_BACKEND_HPP
+#define HANDLER_CGI_BACKEND_HPP
+
+#include <cstddef>
+
+#include "../../server/epoll/manager/EpollManager.hpp"
+#include "Responder.hpp"
+
+namespace handler {
+	namespace cgi {
+		// What the event handler needs from whatever runs a client's CGI request, keyed by the
+		// client's fd: a forked script, a pooled worker or a request on a FastCGI connection.
+		class IBackend {
+			public:
+				virtual ~IBackend() {}
+				virtual size_t writeInput(int, const char*, size_t, server::EpollManager&) = 0;
+				virtual void finishInput(int, server::EpollManager&) = 0;
+				virtual void pauseOutput(int, bool, server::EpollManager&) = 0;
+				virtual bool canSplice() const = 0;
+				virtual int spliceOutput(int) = 0;
+				virtual Responder::Relay* relayOf(int) = 0;
+				virtual void release(int, server::EpollManager&) = 0;
+				virtual bool isProcessing(int) const = 0;
+				virtual bool isCompleted(int) const = 0;
+		};
+	}  // namespace cgi
+}  // namespace handler
+
+#endif
@@ -1,19 +1,86 @@
 // Executor.cpp
 #include "Executor.hpp"
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
 
 #include "../../utils/str_utils.hpp"
 
 using namespace handler::cgi;
 
-void Executor::setArgv(const router::RouteDecision& decision) {
-	_argv.push_back(const_cast<char*>("/usr/bin/python3"));
-	_argv.push_back(const_cast<char*>(decision.fsPath.c_str()));
-	_argv.push_back(NULL);
+std::map<int, pid_t> Executor::_exitFds;
+pthread_mutex_t Executor::_exitLock = PTHREAD_MUTEX_INITIALIZER;
+
+namespace {
+	// vfork() and execve() with the script's CPU time (seconds) and address space (bytes) capped
+	// in the child before exec, which posix_spawn has no way to do. The child runs on the
+	// server's memory and stack until exec, so it touches nothing but what is prepared here,
+	// and signals stay blocked until it has put every handler back to its default.
+	// RLIMIT_CPU sends SIGXCPU at the limit and SIGKILL a second later.
+	pid_t spawnLimited(char* const* args, char* const* envp, int input, int output, int error,
+					   long cpuSeconds, long long memoryBytes) {
+		rlimit cpu;
+		rlimit memory;
+		cpu.rlim_cur = static_cast<rlim_t>(cpuSeconds);
+		cpu.rlim_max = static_cast<rlim_t>(cpuSeconds + 1);
+		memory.rlim_cur = memory.rlim_max = static_cast<rlim_t>(memoryBytes);
+
+		sigset_t all;
+		sigset_t saved;
+		sigset_t none;
+		sigfillset(&all);
+		sigemptyset(&none);
+		struct sigaction defaults;
+		std::memset(&defaults, 0, sizeof(defaults));
+		defaults.sa_handler = SIG_DFL;
+		sigemptyset(&defaults.sa_mask);
+		struct sigaction current;
+
+		pthread_sigmask(SIG_SETMASK, &all, &saved);
+		pid_t pid = vfork();
+		if (pid == 0) {
+			for (int sig = 1; sig < NSIG; ++sig) {
+				if (sigaction(sig, NULL, &current) == 0 && current.sa_handler != SIG_DFL &&
+					(current.sa_handler != SIG_IGN || sig == SIGPIPE))
+					sigaction(sig, &defaults, NULL);
+			}
+			if ((cpuSeconds > 0 && setrlimit(RLIMIT_CPU, &cpu) == -1) ||
+				(memoryBytes > 0 && setrlimit(RLIMIT_AS, &memory) == -1))
+				_exit(127);
+			if (dup2(input, STDIN_FILENO) == -1 || dup2(output, STDOUT_FILENO) == -1 ||
+				(error != -1 && dup2(error, STDERR_FILENO) == -1))
+				_exit(127);
+#ifdef SYS_close_range
+			syscall(SYS_close_range, STDERR_FILENO + 1, ~0U, 0);
+#endif
+			sigprocmask(SIG_SETMASK, &none, NULL);
+			execve(args[0], args, envp);
+			_exit(127);
+		}
+		pthread_sigmask(SIG_SETMASK, &saved, NULL);
+		return pid;
+	}
 }
 
-void Executor::setEnvp(const router::RouteDecision& decision, const http::Packet& request) {
+// The CGI/1.1 meta-variables as NAME=value strings; FastCGI requests carry the same set as
+// their PARAMS.
+void Executor::buildEnvironment(const router::RouteDecision& decision,
+								const http::Packet& request, const sockaddr_in& peer,
+								std::vector<std::string>& env) {
 	std::string requestMethod = http::Method::to_string(request.getStartLine().method);
 	std::string contentType = request.getHeader().get("Content-Type");
 	std::string contentLength = request.getHeader().get("Content-Length");
@@ -22,74 +89,269 @@ void Executor::setEnvp(const router::RouteDecision& decision, const http::Packet
 	std::string serverName = decision.server->getServerName();
 	std::string serverProtocol = request.getStartLine().version;
 	std::string uploadPath = decision.server->getUploadPath();
+	char remoteAddr[INET_ADDRSTRLEN] = "";
+	inet_ntop(AF_INET, &peer.sin_addr, remoteAddr, sizeof(remoteAddr));
 
-	_envStrings.push_back("REQUEST_METHOD=" + requestMethod);
-	_envStrings.push_back("QUERY_STRING=" + decision.queryString);
-	_envStrings.push_back("CONTENT_TYPE=" + contentType);
-	_envStrings.push_back("CONTENT_LENGTH=" + contentLength);
-	_envStrings.push_back("SCRIPT_NAME=" + scriptName);
-	_envStrings.push_back("PATH_INFO=" + decision.fsPath);
-	_envStrings.push_back("PATH_TRANSLATED=" + decision.fsRoot + decision.fsPath);
-	_envStrings.push_back("SERVER_NAME=" + serverName);
-	_envStrings.push_back("SERVER_PORT=" + serverPort);
-	_envStrings.push_back("SERVER_PROTOCOL=" + serverProtocol);
-	_envStrings.push_back("REMOTE_ADDR=127.0.0.1");
-	_envStrings.push_back("REMOTE_PORT=0");
-	_envStrings.push_back("GATEWAY_INTERFACE=CGI/1.1");
-	_envStrings.push_back("UPLOAD_PATH=" + uploadPath);
-
-	for (size_t i = 0; i < _envStrings.size(); ++i) {
-		_envp.push_back(const_cast<char*>(_envStrings[i].c_str()));
-	}
-	_envp.push_back(NULL);
+	env.push_back("REQUEST_METHOD=" + requestMethod);
+	env.push_back("QUERY_STRING=" + decision.queryString);
+	env.push_back("CONTENT_TYPE=" + contentType);
+	env.push_back("CONTENT_LENGTH=" + contentLength);
+	env.push_back("SCRIPT_NAME=" + scriptName);
+	env.push_back("SCRIPT_FILENAME=" + decision.fsPath);
+	env.push_back("PATH_INFO=" + decision.fsPath);
+	env.push_back("PATH_TRANSLATED=" + decision.fsRoot + decision.fsPath);
+	env.push_back("SERVER_NAME=" + serverName);
+	env.push_back("SERVER_PORT=" + serverPort);
+	env.push_back("SERVER_PROTOCOL=" + serverProtocol);
+	env.push_back("REMOTE_ADDR=" + std::string(remoteAddr));
+	env.push_back("REMOTE_PORT=" + int_tostr(ntohs(peer.sin_port)));
+	env.push_back("GATEWAY_INTERFACE=CGI/1.1");
+	// php-cgi refuses to run a script without it (cgi.force_redirect).
+	env.push_back("REDIRECT_STATUS=200");
+	env.push_back("UPLOAD_PATH=" + uploadPath);
 }
 
-void Executor::execute(const router::RouteDecision& decision, const http::Packet& request,
-					   server::EpollManager& epollManager, cgi::ProcessManager& cgiManager,
-					   int clientFd) {
+// Returns false when the script cannot be started.
+bool Executor::execute(const router::RouteDecision& decision, const http::Packet& request,
+					   const sockaddr_in& peer, server::EpollManager& epollManager,
+					   cgi::ProcessManager& cgiManager, int clientFd, bool streamBody) {
 	int stdoutPair[2];
 	int stdinPair[2];
-	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, stdoutPair) == -1 ||
-		socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, stdinPair) == -1) {
-		throw Exception();
-	}
-
-	pid_t pid = fork();
-	if (pid == -1) {
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, stdoutPair) == -1) return false;
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, stdinPair) == -1) {
 		close(stdoutPair[0]);
 		close(stdoutPair[1]);
-		close(stdinPair[0]);
-		close(stdinPair[1]);
-		throw Exception();
+		return false;
 	}
+	// Only the server's ends are non-blocking; the script reads and writes ordinary stdio.
+	fcntl(stdoutPair[0], F_SETFL, O_NONBLOCK);
+	fcntl(stdinPair[0], F_SETFL, O_NONBLOCK);
 
-	if (pid == 0) {
-		close(stdoutPair[0]);
-		close(stdinPair[0]);
-		if (dup2(stdoutPair[1], STDOUT_FILENO) == -1 || dup2(stdoutPair[1], STDERR_FILENO) == -1 ||
-			dup2(stdinPair[1], STDIN_FILENO) == -1) {
-			exit(1);
-		}
-		close(stdoutPair[1]);
-		close(stdinPair[1]);
-
-		setArgv(decision);
-		setEnvp(decision, request);
+	ProcessManager::Launch launch;
+	launch.argv.push_back(decision.cgiInterpreter);
+	launch.argv.push_back(decision.fsPath);
+	buildEnvironment(decision, request, peer, launch.env);
+	launch.childStdin = stdinPair[1];
+	launch.childStdout = stdoutPair[1];
+	launch.cpuLimit = decision.cgiCpuLimit;
+	launch.memoryLimit = decision.cgiMemoryLimit;
+	launch.killDelay = decision.cgiKillTimeout;
 
-		execve(_argv[0], _argv.data(), _envp.data());
-		exit(1);
+	// A spooled body is handed to the script as its stdin file directly instead of being
+	// loaded back into memory and pumped through the socket. The child's stdin shares this
+	// descriptor's offset, so it is rewound here.
+	const http::Body& body = request.getBody();
+	bool post = request.getStartLine().method == http::Method::POST;
+	if (post && body.isFileBacked()) {
+		launch.body = body.getFile();
+		if (lseek(launch.body.getFd(), 0, SEEK_SET) == -1) {
+			close(stdoutPair[0]);
+			close(stdoutPair[1]);
+			close(stdinPair[0]);
+			close(stdinPair[1]);
+			return false;
+		}
 	}
 
-	close(stdoutPair[1]);
-	close(stdinPair[1]);
-
 	std::string bodyPayload;
-	if (request.getStartLine().method == http::Method::POST) {
-		const std::vector<unsigned char>& bodyData = request.getBody().getData();
+	if (post && !body.isFileBacked()) {
+		const std::vector<unsigned char>& bodyData = body.getData();
 		if (!bodyData.empty())
 			bodyPayload.assign(reinterpret_cast<const char*>(bodyData.data()), bodyData.size());
 	}
 
-	cgiManager.registerProcess(pid, stdoutPair[0], stdinPair[0], clientFd, bodyPayload,
-							   epollManager);
+	return cgiManager.registerProcess(launch, stdoutPair[0], stdinPair[0], clientFd, bodyPayload,
+									  streamBody, epollManager);
+}
+
+// Starts a long-running `interpreter program` whose stdin and stdout are both the child end of
+// one socketpair. Returns -1 when it cannot be started.
+pid_t Executor::spawnWorker(const std::string& program, const std::string& interpreter,
+							int& fd) {
+	int pair[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1) return -1;
+	fcntl(pair[0], F_SETFL, O_NONBLOCK);
+
+	std::vector<std::string> argv;
+	argv.push_back(interpreter);
+	argv.push_back(program);
+
+	pid_t pid = spawn(argv, std::vector<std::string>(), pair[1], pair[1], -1, 0, 0);
+	close(pair[1]);
+	if (pid == -1) {
+		close(pair[0]);
+		return -1;
+	}
+	fd = pair[0];
+	return pid;
+}
+
+// Runs argv with env through posix_spawn, which on Linux starts the child on the server's own
+// memory until exec (clone with CLONE_VM | CLONE_VFORK) instead of copying its page tables as
+// fork() does, so its cost does not grow with the server's footprint. The child gets `input`,
+// `output` and `error` as its stdio (`error` -1 keeps the server's stderr), SIGPIPE back at its
+// default, and no other descriptor. A script with resource limits is started by
+// spawnLimited() instead. Returns -1 when it cannot be started.
+pid_t Executor::spawn(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+					  int input, int output, int error, long cpuSeconds, long long memoryBytes) {
+	std::vector<char*> args;
+	std::vector<char*> envp;
+	for (size_t i = 0; i < argv.size(); ++i) args.push_back(const_cast<char*>(argv[i].c_str()));
+	for (size_t i = 0; i < env.size(); ++i) envp.push_back(const_cast<char*>(env[i].c_str()));
+	args.push_back(NULL);
+	envp.push_back(NULL);
+	if (cpuSeconds > 0 || memoryBytes > 0)
+		return spawnLimited(args.data(), envp.data(), input, output, error, cpuSeconds,
+							memoryBytes);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attributes;
+	if (posix_spawn_file_actions_init(&actions) != 0) return -1;
+	if (posix_spawnattr_init(&attributes) != 0) {
+		posix_spawn_file_actions_destroy(&actions);
+		return -1;
+	}
+
+	sigset_t defaults;
+	sigset_t mask;
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGPIPE);
+	sigemptyset(&mask);
+	posix_spawnattr_setsigdefault(&attributes, &defaults);
+	posix_spawnattr_setsigmask(&attributes, &mask);
+	posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+	posix_spawn_file_actions_adddup2(&actions, input, STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, output, STDOUT_FILENO);
+	if (error != -1) posix_spawn_file_actions_adddup2(&actions, error, STDERR_FILENO);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+	posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+
+	pid_t pid = -1;
+	int status = posix_spawn(&pid, args[0], &actions, &attributes, args.data(), envp.data());
+	posix_spawnattr_destroy(&attributes);
+	posix_spawn_file_actions_destroy(&actions);
+	return status == 0 ? pid : -1;
+}
+
+// Prepares the calling thread for watch(). Where pidfd_open() is missing (Linux before 5.3),
+// children are watched through eventfds that collectExits() sets once SIGCHLD reports them
+// gone: SIGCHLD is blocked here and read from the signalfd returned, which the caller polls.
+// Returns -1 when pidfds work and nothing else is needed.
+int Executor::watchExits() {
+#ifdef SYS_pidfd_open
+	int probe = static_cast<int>(syscall(SYS_pidfd_open, getpid(), 0));
+	if (probe != -1) {
+		close(probe);
+		return -1;
+	}
+#endif
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd == -1)
+		throw handler::Exception("[Error] CGI exits cannot be watched: no pidfd_open or signalfd");
+	std::cerr << "[Warn] pidfd_open unavailable, watching CGI exits through SIGCHLD" << std::endl;
+	return fd;
+}
+
+// SIGCHLD does not say which children exited, and signals sent close together merge, so every
+// watched child is checked. Any thread's signalfd may have read it, hence the shared list.
+void Executor::collectExits(int signalFd) {
+	signalfd_siginfo info;
+	while (read(signalFd, &info, sizeof(info)) > 0) {
+	}
+	pthread_mutex_lock(&_exitLock);
+	for (std::map<int, pid_t>::iterator it = _exitFds.begin(); it != _exitFds.end(); ++it)
+		notifyExit(it->first, it->second);
+	pthread_mutex_unlock(&_exitLock);
+}
+
+// Makes `fd` readable if `pid` has exited, leaving it to reap() to collect.
+void Executor::notifyExit(int fd, pid_t pid) {
+	siginfo_t info;
+	info.si_pid = 0;
+	if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid != pid)
+		return;
+	uint64_t one = 1;
+	ssize_t written = write(fd, &one, sizeof(one));
+	(void) written;
+}
+
+int Executor::watchWithEventfd(pid_t pid) {
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd == -1) return -1;
+	pthread_mutex_lock(&_exitLock);
+	_exitFds[fd] = pid;
+	// Its SIGCHLD may have been read before it was listed.
+	notifyExit(fd, pid);
+	pthread_mutex_unlock(&_exitLock);
+	return fd;
+}
+
+// Opens a pidfd for a child just started. It polls readable once the child has exited, so the
+// exit reaches the event loop as an ordinary event instead of through SIGCHLD, and until reap()
+// collects the child its pid cannot be reused, so signals sent through it never go astray.
+// Without pidfds an eventfd set by collectExits() stands in for it. If neither can be opened
+// the child is killed and collected here and -1 returned.
+int Executor::watch(pid_t pid) {
+	int fd = -1;
+#ifdef SYS_pidfd_open
+	fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+	if (fd == -1 && errno == ENOSYS) fd = watchWithEventfd(pid);
+#else
+	fd = watchWithEventfd(pid);
+#endif
+	if (fd == -1) {
+		int status;
+		kill(pid, SIGKILL);
+		while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+		}
+	}
+	return fd;
+}
+
+// For a descriptor from watch() closed without its child being reaped.
+void Executor::unwatch(int fd) {
+	pthread_mutex_lock(&_exitLock);
+	_exitFds.erase(fd);
+	pthread_mutex_unlock(&_exitLock);
+}
+
+// Collects a child whose pidfd has turned readable. Returns false if it has not exited.
+bool Executor::reap(pid_t pid, int& status) {
+	pid_t done;
+	do {
+		done = waitpid(pid, &status, WNOHANG);
+	} while (done == -1 && errno == EINTR);
+	if (done != pid) return false;
+
+	pthread_mutex_lock(&_exitLock);
+	for (std::map<int, pid_t>::iterator it = _exitFds.begin(); it != _exitFds.end(); ++it) {
+		if (it->second != pid) continue;
+		_exitFds.erase(it);
+		break;
+	}
+	pthread_mutex_unlock(&_exitLock);
+	return true;
+}
+
+// A child watched through an eventfd is signalled by pid, which is as safe: it is not reused
+// before reap() has collected the child.
+void Executor::sendSignal(int fd, int sig) {
+	pid_t pid = -1;
+	pthread_mutex_lock(&_exitLock);
+	std::map<int, pid_t>::const_iterator it = _exitFds.find(fd);
+	if (it != _exitFds.end()) pid = it->second;
+	pthread_mutex_unlock(&_exitLock);
+	if (pid != -1) {
+		kill(pid, sig);
+		return;
+	}
+#ifdef SYS_pidfd_send_signal
+	syscall(SYS_pidfd_send_signal, fd, sig, NULL, 0);
+#endif
 }
@@ -2,6 +2,8 @@
 #ifndef HANDLER_CGI_EXECUTOR_HPP
 #define HANDLER_CGI_EXECUTOR_HPP
 
+#include <netinet/in.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -18,18 +20,29 @@ namespace handler {
 	namespace cgi {
 		class Executor {
 			private:
-				std::vector<std::string> _envStrings;
-				std::vector<char*> _envp;
-				std::vector<char*> _argv;
+				// Children watched through an eventfd instead of a pidfd, by descriptor.
+				static std::map<int, pid_t> _exitFds;
+				static pthread_mutex_t _exitLock;
 
-				void setArgv(const router::RouteDecision&);
-				void setEnvp(const router::RouteDecision&, const http::Packet&);
+				static int watchWithEventfd(pid_t);
+				static void notifyExit(int, pid_t);
 
 			public:
 				Executor() {}
 				~Executor() {}
-				void execute(const router::RouteDecision&, const http::Packet&,
-							 server::EpollManager&, cgi::ProcessManager&, int);
+				static void buildEnvironment(const router::RouteDecision&, const http::Packet&,
+											 const sockaddr_in&, std::vector<std::string>&);
+				bool execute(const router::RouteDecision&, const http::Packet&, const sockaddr_in&,
+							 server::EpollManager&, cgi::ProcessManager&, int, bool);
+				pid_t spawnWorker(const std::string&, const std::string&, int&);
+				static pid_t spawn(const std::vector<std::string>&, const std::vector<std::string>&,
+								   int, int, int, long, long long);
+				static int watchExits();
+				static void collectExits(int);
+				static int watch(pid_t);
+				static void unwatch(int);
+				static bool reap(pid_t, int&);
+				static void sendSignal(int, int);
 		};
 	}  // namespace cgi
 }  // namespace handler
@@ -0,0 +1,544 @@
+// FastCgiClient.cpp
+#include "FastCgiClient.hpp"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../router/utils/fs.hpp"
+#include "Executor.hpp"
+
+using namespace handler::cgi;
+
+namespace {
+	const unsigned char kVersion = 1;
+	const unsigned char kBeginRequest = 1;
+	const unsigned char kAbortRequest = 2;
+	const unsigned char kEndRequest = 3;
+	const unsigned char kParams = 4;
+	const unsigned char kStdin = 5;
+	const unsigned char kStdout = 6;
+	const unsigned char kGetValues = 9;
+	const unsigned char kGetValuesResult = 10;
+	const unsigned char kResponder = 1;
+	const unsigned char kKeepConn = 1;
+	const unsigned char kRequestComplete = 0;
+
+	const size_t kHeaderSize = 8;
+	const size_t kRecordSize = 32 * 1024;
+	const size_t kWriteWater = 64 * 1024;
+	const size_t kReadSize = 16 * 1024;
+	const size_t kReadBudget = 256 * 1024;
+	const size_t kMaxRequests = 64;
+	const size_t kMaxIdleConnections = 8;
+
+	void appendLength(std::string& out, size_t length) {
+		if (length < 128) {
+			out += static_cast<char>(length);
+			return;
+		}
+		out += static_cast<char>(0x80 | ((length >> 24) & 0x7f));
+		out += static_cast<char>((length >> 16) & 0xff);
+		out += static_cast<char>((length >> 8) & 0xff);
+		out += static_cast<char>(length & 0xff);
+	}
+
+	void appendPair(std::string& out, const std::string& name, const std::string& value) {
+		appendLength(out, name.size());
+		appendLength(out, value.size());
+		out += name;
+		out += value;
+	}
+
+	bool readLength(const unsigned char* data, size_t size, size_t& offset, size_t& length) {
+		if (offset >= size) return false;
+		if (!(data[offset] & 0x80)) {
+			length = data[offset++];
+			return true;
+		}
+		if (size - offset < 4) return false;
+		length = (static_cast<size_t>(data[offset] & 0x7f) << 24) |
+				 (static_cast<size_t>(data[offset + 1]) << 16) |
+				 (static_cast<size_t>(data[offset + 2]) << 8) | data[offset + 3];
+		offset += 4;
+		return true;
+	}
+
+	// The backend runs in a directory of its own, so paths under a relative root are sent
+	// absolute, as fcgiwrap and php-fpm expect.
+	std::string absolutePath(const std::string& path) {
+		char cwd[PATH_MAX];
+		if (path.empty() || path[0] == '/' || !getcwd(cwd, sizeof(cwd))) return path;
+		return router::utils::join(cwd, path.compare(0, 2, "./") == 0 ? path.substr(2) : path);
+	}
+
+	size_t pendingOutput(const std::string& output, size_t offset) {
+		return output.size() - offset;
+	}
+
+	void wake(std::vector<int>& clients, int clientFd) {
+		if (std::find(clients.begin(), clients.end(), clientFd) == clients.end())
+			clients.push_back(clientFd);
+	}
+}
+
+FastCgiClient::~FastCgiClient() {
+	for (std::map<int, Upstream>::iterator it = _upstreams.begin(); it != _upstreams.end(); ++it)
+		close(it->first);
+}
+
+// Picks a pooled connection to the backend that can take one more request, or opens one.
+FastCgiClient::Upstream* FastCgiClient::acquire(const std::string& path,
+												server::EpollManager& epollManager) {
+	for (std::map<int, Upstream>::iterator it = _upstreams.begin(); it != _upstreams.end(); ++it) {
+		Upstream& upstream = it->second;
+		if (upstream.path != path) continue;
+		if (upstream.requests.empty() ||
+			(upstream.multiplexed && upstream.requests.size() < upstream.maxRequests))
+			return &upstream;
+	}
+	return connect(path, epollManager);
+}
+
+FastCgiClient::Upstream* FastCgiClient::connect(const std::string& path,
+												server::EpollManager& epollManager) {
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) return NULL;
+	std::memcpy(address.sun_path, path.c_str(), path.size());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) return NULL;
+	// A unix socket connects at once or not at all; EAGAIN means the backend's backlog is full.
+	if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 &&
+		errno != EINPROGRESS) {
+		close(fd);
+		return NULL;
+	}
+
+	Upstream& upstream = _upstreams[fd];
+	upstream.fd = fd;
+	upstream.path = path;
+	upstream.maxRequests = kMaxRequests;
+
+	std::string values;
+	appendPair(values, "FCGI_MPXS_CONNS", "");
+	appendPair(values, "FCGI_MAX_REQS", "");
+	queueRecord(upstream, kGetValues, 0, values.data(), values.size());
+
+	upstream.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	epollManager.add(fd, upstream.events);
+	return &upstream;
+}
+
+FastCgiClient::Request* FastCgiClient::findRequest(int clientFd) {
+	std::map<int, Request>::iterator it = _requests.find(clientFd);
+	return it == _requests.end() ? NULL : &it->second;
+}
+
+const FastCgiClient::Request* FastCgiClient::findRequest(int clientFd) const {
+	std::map<int, Request>::const_iterator it = _requests.find(clientFd);
+	return it == _requests.end() ? NULL : &it->second;
+}
+
+size_t FastCgiClient::idleCount(const std::string& path) const {
+	size_t count = 0;
+	for (std::map<int, Upstream>::const_iterator it = _upstreams.begin(); it != _upstreams.end();
+		 ++it) {
+		if (it->second.path == path && it->second.requests.empty()) count++;
+	}
+	return count;
+}
+
+void FastCgiClient::queueRecord(Upstream& upstream, unsigned char type, unsigned short id,
+								const char* data, size_t length) {
+	size_t padding = (8 - length % 8) % 8;
+	unsigned char header[kHeaderSize] = {kVersion,
+										 type,
+										 static_cast<unsigned char>(id >> 8),
+										 static_cast<unsigned char>(id & 0xff),
+										 static_cast<unsigned char>(length >> 8),
+										 static_cast<unsigned char>(length & 0xff),
+										 static_cast<unsigned char>(padding),
+										 0};
+	upstream.output.append(reinterpret_cast<const char*>(header), kHeaderSize);
+	if (length > 0) upstream.output.append(data, length);
+	upstream.output.append(padding, '\0');
+}
+
+// Splits a stream's data across records; the empty record that ends a stream is queued apart.
+void FastCgiClient::queueStream(Upstream& upstream, unsigned char type, unsigned short id,
+								const char* data, size_t length) {
+	for (size_t offset = 0; offset < length; offset += kRecordSize)
+		queueRecord(upstream, type, id, data + offset, std::min(kRecordSize, length - offset));
+}
+
+// Spooled request bodies are read from their file as the connection drains, so only about
+// kWriteWater of them is held in memory at a time.
+void FastCgiClient::feedBodies(Upstream& upstream) {
+	char buffer[kRecordSize];
+
+	for (std::map<unsigned short, int>::iterator it = upstream.requests.begin();
+		 it != upstream.requests.end(); ++it) {
+		Request* request = it->second == -1 ? NULL : findRequest(it->second);
+		while (request && request->body.isOpen() &&
+			   pendingOutput(upstream.output, upstream.outputOffset) < kWriteWater) {
+			const http::FileRegion& body = request->body;
+			size_t left = body.getLength() - request->bodySent;
+			ssize_t got = 0;
+			if (left > 0)
+				got = pread(body.getFd(), buffer, std::min(left, kRecordSize),
+							body.getOffset() + static_cast<off_t>(request->bodySent));
+			if (got > 0) {
+				queueRecord(upstream, kStdin, request->id, buffer, static_cast<size_t>(got));
+				request->bodySent += static_cast<size_t>(got);
+				continue;
+			}
+			if (got == -1 && errno == EINTR) continue;
+			queueRecord(upstream, kStdin, request->id, NULL, 0);
+			request->body = http::FileRegion();
+		}
+	}
+}
+
+bool FastCgiClient::flush(Upstream& upstream, std::vector<int>& clients) {
+	bool blocked = false;
+
+	while (!blocked) {
+		while (upstream.outputOffset < upstream.output.size()) {
+			ssize_t written = write(upstream.fd, upstream.output.data() + upstream.outputOffset,
+									upstream.output.size() - upstream.outputOffset);
+			if (written > 0) {
+				upstream.outputOffset += static_cast<size_t>(written);
+				continue;
+			}
+			if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				blocked = true;
+				break;
+			}
+			if (written == -1 && errno == EINTR) continue;
+			return false;
+		}
+		if (blocked) break;
+		upstream.output.clear();
+		upstream.outputOffset = 0;
+		feedBodies(upstream);
+		if (upstream.output.empty()) break;
+	}
+	if (upstream.outputOffset >= kWriteWater) {
+		upstream.output.erase(0, upstream.outputOffset);
+		upstream.outputOffset = 0;
+	}
+
+	if (pendingOutput(upstream.output, upstream.outputOffset) >= kWriteWater) return true;
+	for (std::map<unsigned short, int>::iterator it = upstream.requests.begin();
+		 it != upstream.requests.end(); ++it) {
+		Request* request = it->second == -1 ? NULL : findRequest(it->second);
+		if (!request || !request->inputBlocked) continue;
+		request->inputBlocked = false;
+		wake(clients, it->second);
+	}
+	return true;
+}
+
+// Reads are bounded per event like a script's stdout, and stop while any client on the
+// connection is behind; a backend that hung up is drained whole. Returns false once the
+// connection is unusable.
+bool FastCgiClient::receive(Upstream& upstream, uint32_t events,
+							server::EpollManager& epollManager, std::vector<int>& clients) {
+	bool hangup = events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+	if (!hangup && (!(events & EPOLLIN) || upstream.paused)) return true;
+
+	std::vector<unsigned char>& buffer = upstream.input;
+	size_t budget = kReadBudget;
+	bool open = true;
+	while (hangup || budget > 0) {
+		size_t used = buffer.size();
+		buffer.resize(used + kReadSize);
+		ssize_t n = read(upstream.fd, &buffer[used], kReadSize);
+		buffer.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
+		if (n > 0) {
+			budget -= std::min(budget, static_cast<size_t>(n));
+			continue;
+		}
+		if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		if (n == -1 && errno == EINTR) continue;
+		open = false;
+		break;
+	}
+	if (!parseRecords(upstream, clients)) return false;
+	if (open && budget == 0) epollManager.modify(upstream.fd, upstream.events);
+	return open;
+}
+
+bool FastCgiClient::parseRecords(Upstream& upstream, std::vector<int>& clients) {
+	std::vector<unsigned char>& input = upstream.input;
+	size_t offset = 0;
+
+	while (input.size() - offset >= kHeaderSize) {
+		const unsigned char* header = &input[offset];
+		if (header[0] != kVersion) return false;
+		unsigned char type = header[1];
+		unsigned short id = static_cast<unsigned short>((header[2] << 8) | header[3]);
+		size_t length = (static_cast<size_t>(header[4]) << 8) | header[5];
+		size_t recordSize = kHeaderSize + length + header[6];
+		if (input.size() - offset < recordSize) break;
+		const unsigned char* content = header + kHeaderSize;
+
+		if (type == kGetValuesResult) {
+			readValues(upstream, content, length);
+		} else if (type == kStdout) {
+			std::map<unsigned short, int>::iterator it = upstream.requests.find(id);
+			Request* request =
+				it == upstream.requests.end() || it->second == -1 ? NULL : findRequest(it->second);
+			if (request && length > 0) {
+				request->relay.buffer.insert(request->relay.buffer.end(), content,
+											 content + length);
+				wake(clients, it->second);
+			}
+		} else if (type == kEndRequest) {
+			endRequest(upstream, id, content, length, clients);
+		}
+		offset += recordSize;
+	}
+	input.erase(input.begin(), input.begin() + offset);
+	return true;
+}
+
+// Like a script's exit status, a non-zero application status or a request the backend could
+// not complete marks the relay failed, and so does a request that ended without any output.
+void FastCgiClient::endRequest(Upstream& upstream, unsigned short id,
+							   const unsigned char* content, size_t length,
+							   std::vector<int>& clients) {
+	std::map<unsigned short, int>::iterator it = upstream.requests.find(id);
+	if (it == upstream.requests.end()) return;
+	int clientFd = it->second;
+	upstream.requests.erase(it);
+
+	Request* request = clientFd == -1 ? NULL : findRequest(clientFd);
+	if (!request) return;
+	if (request->paused) upstream.paused--;
+	request->upstreamFd = -1;
+	request->completed = true;
+	request->inputBlocked = false;
+	request->body = http::FileRegion();
+	bool silent =
+		request->relay.framing == Responder::Relay::Head && request->relay.buffer.empty();
+	bool succeeded = length >= 5 && content[0] == 0 && content[1] == 0 && content[2] == 0 &&
+					 content[3] == 0 && content[4] == kRequestComplete;
+	if (silent || !succeeded) request->relay.failed = true;
+	wake(clients, clientFd);
+}
+
+void FastCgiClient::readValues(Upstream& upstream, const unsigned char* data, size_t size) {
+	size_t offset = 0;
+	size_t nameLength;
+	size_t valueLength;
+
+	while (readLength(data, size, offset, nameLength) &&
+		   readLength(data, size, offset, valueLength) &&
+		   nameLength + valueLength <= size - offset) {
+		std::string name(reinterpret_cast<const char*>(data + offset), nameLength);
+		std::string value(reinterpret_cast<const char*>(data + offset + nameLength), valueLength);
+		offset += nameLength + valueLength;
+
+		if (name == "FCGI_MPXS_CONNS") {
+			upstream.multiplexed = value == "1";
+		} else if (name == "FCGI_MAX_REQS") {
+			long maxRequests = std::strtol(value.c_str(), NULL, 10);
+			if (maxRequests > 0)
+				upstream.maxRequests = std::min(kMaxRequests, static_cast<size_t>(maxRequests));
+		}
+	}
+}
+
+void FastCgiClient::updateEvents(Upstream& upstream, server::EpollManager& epollManager) {
+	unsigned int events = EPOLLRDHUP | EPOLLET;
+	if (!upstream.paused) events |= EPOLLIN;
+	if (upstream.outputOffset < upstream.output.size()) events |= EPOLLOUT;
+	if (events == upstream.events) return;
+	epollManager.modify(upstream.fd, events);
+	upstream.events = events;
+}
+
+// Ends every request still on the connection as failed: one without a head yet gets a 502, one
+// whose body has started has its connection closed.
+void FastCgiClient::closeUpstream(Upstream& upstream, std::vector<int>& clients,
+								  server::EpollManager& epollManager) {
+	for (std::map<unsigned short, int>::iterator it = upstream.requests.begin();
+		 it != upstream.requests.end(); ++it) {
+		Request* request = it->second == -1 ? NULL : findRequest(it->second);
+		if (!request) continue;
+		request->upstreamFd = -1;
+		request->completed = true;
+		request->relay.failed = true;
+		request->inputBlocked = false;
+		request->body = http::FileRegion();
+		wake(clients, it->second);
+	}
+	int fd = upstream.fd;
+	_upstreams.erase(fd);
+	epollManager.remove(fd);
+}
+
+// Queues the whole request on a pooled connection: BEGIN_REQUEST asking the backend to keep
+// the connection, the CGI environment as PARAMS, and unless the body is to be streamed in,
+// STDIN. Returns false when the backend cannot be reached.
+bool FastCgiClient::start(const router::RouteDecision& decision, const http::Packet& request,
+						  const sockaddr_in& peer, int clientFd, bool streamBody,
+						  server::EpollManager& epollManager) {
+	Upstream* upstream = acquire(decision.fastcgiPass, epollManager);
+	if (!upstream) return false;
+
+	unsigned short id = 1;
+	while (upstream->requests.find(id) != upstream->requests.end()) id++;
+	upstream->requests[id] = clientFd;
+	Request& stored = _requests[clientFd];
+	stored = Request();
+	stored.upstreamFd = upstream->fd;
+	stored.id = id;
+
+	const char begin[] = {0, static_cast<char>(kResponder), static_cast<char>(kKeepConn), 0, 0, 0,
+						  0, 0};
+	queueRecord(*upstream, kBeginRequest, id, begin, sizeof(begin));
+
+	std::vector<std::string> env;
+	Executor::buildEnvironment(decision, request, peer, env);
+	std::string params;
+	for (size_t i = 0; i < env.size(); ++i) {
+		size_t eq = env[i].find('=');
+		std::string name = env[i].substr(0, eq);
+		std::string value = env[i].substr(eq + 1);
+		if (name == "SCRIPT_FILENAME" || name == "UPLOAD_PATH") value = absolutePath(value);
+		appendPair(params, name, value);
+	}
+	queueStream(*upstream, kParams, id, params.data(), params.size());
+	queueRecord(*upstream, kParams, id, NULL, 0);
+
+	if (!streamBody) {
+		const http::Body& body = request.getBody();
+		if (request.getStartLine().method == http::Method::POST && body.isFileBacked()) {
+			stored.body = body.getFile();
+		} else {
+			const std::vector<unsigned char>& data = body.getData();
+			if (request.getStartLine().method == http::Method::POST && !data.empty())
+				queueStream(*upstream, kStdin, id, reinterpret_cast<const char*>(data.data()),
+							data.size());
+			queueRecord(*upstream, kStdin, id, NULL, 0);
+		}
+		feedBodies(*upstream);
+	}
+	updateEvents(*upstream, epollManager);
+	return true;
+}
+
+void FastCgiClient::handleEvent(int fd, uint32_t events, server::EpollManager& epollManager,
+								std::vector<int>& clients) {
+	std::map<int, Upstream>::iterator it = _upstreams.find(fd);
+	if (it == _upstreams.end()) return;
+	Upstream& upstream = it->second;
+
+	bool usable = true;
+	if (events & EPOLLOUT) usable = flush(upstream, clients);
+	if (usable) usable = receive(upstream, events, epollManager, clients);
+	if (!usable || (upstream.requests.empty() && idleCount(upstream.path) > kMaxIdleConnections)) {
+		closeUpstream(upstream, clients, epollManager);
+		return;
+	}
+	updateEvents(upstream, epollManager);
+}
+
+bool FastCgiClient::isConnection(int fd) const {
+	return _upstreams.find(fd) != _upstreams.end();
+}
+
+// Streamed request bodies are queued as STDIN records while the connection is keeping up.
+// Returns how much was taken; a short count wakes the client again once the queue drains.
+size_t FastCgiClient::writeInput(int clientFd, const char* data, size_t length,
+								 server::EpollManager& epollManager) {
+	Request* request = findRequest(clientFd);
+	if (!request || request->upstreamFd == -1) return length;
+	Upstream& upstream = _upstreams[request->upstreamFd];
+
+	size_t pending = pendingOutput(upstream.output, upstream.outputOffset);
+	size_t taken = pending < kWriteWater ? std::min(length, kWriteWater - pending) : 0;
+	queueStream(upstream, kStdin, request->id, data, taken);
+	request->inputBlocked = taken < length;
+	updateEvents(upstream, epollManager);
+	return taken;
+}
+
+void FastCgiClient::finishInput(int clientFd, server::EpollManager& epollManager) {
+	Request* request = findRequest(clientFd);
+	if (!request || request->upstreamFd == -1) return;
+	Upstream& upstream = _upstreams[request->upstreamFd];
+	queueRecord(upstream, kStdin, request->id, NULL, 0);
+	updateEvents(upstream, epollManager);
+}
+
+// FastCGI has no flow control of its own, so a client that is behind stops reads from the
+// whole connection until it catches up.
+void FastCgiClient::pauseOutput(int clientFd, bool paused, server::EpollManager& epollManager) {
+	Request* request = findRequest(clientFd);
+	if (!request || request->paused == paused) return;
+	request->paused = paused;
+	if (request->upstreamFd == -1) return;
+	Upstream& upstream = _upstreams[request->upstreamFd];
+	upstream.paused += paused ? 1 : -1;
+	updateEvents(upstream, epollManager);
+}
+
+bool FastCgiClient::canSplice() const {
+	return false;
+}
+
+int FastCgiClient::spliceOutput(int clientFd) {
+	(void) clientFd;
+	return -1;
+}
+
+Responder::Relay* FastCgiClient::relayOf(int clientFd) {
+	Request* request = findRequest(clientFd);
+	return request ? &request->relay : NULL;
+}
+
+// A request dropped before the backend ended it is aborted. A multiplexed connection keeps its
+// id reserved until the backend confirms; any other connection is closed with it, since
+// waiting for the script would hold the connection for nobody.
+void FastCgiClient::release(int clientFd, server::EpollManager& epollManager) {
+	std::map<int, Request>::iterator it = _requests.find(clientFd);
+	if (it == _requests.end()) return;
+	Request& request = it->second;
+
+	std::map<int, Upstream>::iterator upIt = _upstreams.find(request.upstreamFd);
+	if (upIt != _upstreams.end()) {
+		Upstream& upstream = upIt->second;
+		if (request.paused) upstream.paused--;
+		if (upstream.multiplexed) {
+			upstream.requests[request.id] = -1;
+			queueRecord(upstream, kAbortRequest, request.id, NULL, 0);
+			updateEvents(upstream, epollManager);
+		} else {
+			_upstreams.erase(upIt);
+			epollManager.remove(request.upstreamFd);
+		}
+	}
+	_requests.erase(it);
+}
+
+bool FastCgiClient::isProcessing(int clientFd) const {
+	return findRequest(clientFd) != NULL;
+}
+
+bool FastCgiClient::isCompleted(int clientFd) const {
+	const Request* request = findRequest(clientFd);
+	return request && request->completed;
+}
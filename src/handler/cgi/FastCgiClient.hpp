@@ -0,0 +1,114 @@
+// FastCgiClient.hpp
+#ifndef HANDLER_CGI_FASTCGI_CLIENT_HPP
+#define HANDLER_CGI_FASTCGI_CLIENT_HPP
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../http/model/FileRegion.hpp"
+#include "../../http/model/Packet.hpp"
+#include "../../router/model/RouteDecision.hpp"
+#include "../../server/epoll/manager/EpollManager.hpp"
+#include "Backend.hpp"
+#include "Responder.hpp"
+
+namespace handler {
+	namespace cgi {
+		// Runs CGI requests on long-running FastCGI backends reached through unix sockets.
+		// Connections are kept open between requests and pooled per socket path; one whose
+		// backend answers FCGI_GET_VALUES with FCGI_MPXS_CONNS=1 carries several requests at
+		// once, any other carries one at a time. Sockets are only read and written from their
+		// own events, so a failed connection always reports the clients it was serving.
+		class FastCgiClient : public IBackend {
+			private:
+				struct Request {
+						int upstreamFd;
+						unsigned short id;
+						Responder::Relay relay;
+						http::FileRegion body;
+						size_t bodySent;
+						bool completed;
+						bool inputBlocked;
+						bool paused;
+
+						Request() :
+							upstreamFd(-1),
+							id(0),
+							bodySent(0),
+							completed(false),
+							inputBlocked(false),
+							paused(false) {}
+				};
+
+				struct Upstream {
+						int fd;
+						std::string path;
+						std::string output;
+						size_t outputOffset;
+						std::vector<unsigned char> input;
+						// Request id to client fd; an aborted request keeps its id as -1 until
+						// the backend ends it.
+						std::map<unsigned short, int> requests;
+						size_t maxRequests;
+						bool multiplexed;
+						int paused;
+						unsigned int events;
+
+						Upstream() :
+							fd(-1),
+							outputOffset(0),
+							maxRequests(0),
+							multiplexed(false),
+							paused(0),
+							events(0) {}
+				};
+
+				std::map<int, Upstream> _upstreams;
+				std::map<int, Request> _requests;
+
+				FastCgiClient(const FastCgiClient&);
+				FastCgiClient& operator=(const FastCgiClient&);
+
+				Upstream* acquire(const std::string&, server::EpollManager&);
+				Upstream* connect(const std::string&, server::EpollManager&);
+				Request* findRequest(int);
+				const Request* findRequest(int) const;
+				size_t idleCount(const std::string&) const;
+				void queueRecord(Upstream&, unsigned char, unsigned short, const char*, size_t);
+				void queueStream(Upstream&, unsigned char, unsigned short, const char*, size_t);
+				void feedBodies(Upstream&);
+				bool flush(Upstream&, std::vector<int>&);
+				bool receive(Upstream&, uint32_t, server::EpollManager&, std::vector<int>&);
+				bool parseRecords(Upstream&, std::vector<int>&);
+				void endRequest(Upstream&, unsigned short, const unsigned char*, size_t,
+								std::vector<int>&);
+				void readValues(Upstream&, const unsigned char*, size_t);
+				void updateEvents(Upstream&, server::EpollManager&);
+				void closeUpstream(Upstream&, std::vector<int>&, server::EpollManager&);
+
+			public:
+				FastCgiClient() {}
+				~FastCgiClient();
+
+				bool start(const router::RouteDecision&, const http::Packet&, const sockaddr_in&, int,
+						   bool, server::EpollManager&);
+				void handleEvent(int, uint32_t, server::EpollManager&, std::vector<int>&);
+				bool isConnection(int) const;
+				virtual size_t writeInput(int, const char*, size_t, server::EpollManager&);
+				virtual void finishInput(int, server::EpollManager&);
+				virtual void pauseOutput(int, bool, server::EpollManager&);
+				virtual bool canSplice() const;
+				virtual int spliceOutput(int);
+				virtual Responder::Relay* relayOf(int);
+				virtual void release(int, server::EpollManager&);
+				virtual bool isProcessing(int) const;
+				virtual bool isCompleted(int) const;
+		};
+	}  // namespace cgi
+}  // namespace handler
+
+#endif
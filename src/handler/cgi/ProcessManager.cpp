@@ -5,22 +5,23 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <cerrno>
 
+#include "../../server/timer/TimerWheel.hpp"
+#include "Executor.hpp"
+
 using namespace handler::cgi;
 
 namespace {
 	const unsigned int kStdoutEvents = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	const unsigned int kPausedStdoutEvents = EPOLLRDHUP | EPOLLET;
+	const unsigned int kIdleStdoutEvents = EPOLLET;
+	const size_t kStdoutReadSize = 16 * 1024;
+	const size_t kStdoutReadBudget = 256 * 1024;
 	const unsigned int kStdinEvents = EPOLLOUT | EPOLLET;
 }
 
-void ProcessManager::sigchldHandler(int sig) {
-	(void) sig;
-	int status;
-	while (waitpid(-1, &status, WNOHANG) > 0) {
-	}
-}
-
 void ProcessManager::closeFdQuiet(int fd) {
 	if (fd >= 0) close(fd);
 }
@@ -36,7 +37,7 @@ void ProcessManager::detachStdout(Process& process, server::EpollManager& epollM
 	} else
 		closeFdQuiet(fd);
 	process.stdoutClosed = true;
-	process.completed = true;
+	process.completed = process.exited;
 }
 
 void ProcessManager::detachStdin(Process& process, server::EpollManager& epollManager) {
@@ -44,20 +45,41 @@ void ProcessManager::detachStdin(Process& process, server::EpollManager& epollMa
 	if (fd < 0) return;
 
 	process.stdinFd = -1;
+	process.inputOpen = false;
 	_stdinToStdout.erase(fd);
 	if (process.stdinRegistered) {
 		epollManager.remove(fd);
 		process.stdinRegistered = false;
+		process.stdinArmed = false;
 	} else
 		closeFdQuiet(fd);
 }
 
-void ProcessManager::trySendPendingInput(Process& process, server::EpollManager& epollManager) {
-	if (process.stdinFd < 0) return;
-	if (process.inputOffset >= process.input.size()) {
-		detachStdin(process, epollManager);
+// Write interest is only held while the socket is full; a streamed stdin that has nothing to
+// send would otherwise be woken each time the script reads from it.
+void ProcessManager::armStdin(Process& process, bool armed, server::EpollManager& epollManager) {
+	if (!process.stdinRegistered) {
+		if (!armed) return;
+		epollManager.add(process.stdinFd, kStdinEvents);
+		process.stdinRegistered = true;
+		process.stdinArmed = true;
 		return;
 	}
+	if (process.stdinArmed == armed) return;
+	epollManager.modify(process.stdinFd, armed ? kStdinEvents : EPOLLET);
+	process.stdinArmed = armed;
+}
+
+ProcessManager::Process* ProcessManager::findByClient(int clientFd) {
+	std::map<int, int>::iterator it = _clientToStdout.find(clientFd);
+	if (it == _clientToStdout.end()) return NULL;
+	std::map<int, Process>::iterator procIt = _processes.find(it->second);
+	if (procIt == _processes.end()) return NULL;
+	return &procIt->second;
+}
+
+void ProcessManager::trySendPendingInput(Process& process, server::EpollManager& epollManager) {
+	if (process.stdinFd < 0) return;
 
 	while (process.inputOffset < process.input.size()) {
 		ssize_t written = write(process.stdinFd, process.input.data() + process.inputOffset,
@@ -67,10 +89,7 @@ void ProcessManager::trySendPendingInput(Process& process, server::EpollManager&
 			continue;
 		}
 		if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-			if (!process.stdinRegistered) {
-				epollManager.add(process.stdinFd, kStdinEvents);
-				process.stdinRegistered = true;
-			}
+			armStdin(process, true, epollManager);
 			return;
 		}
 		if (written == -1 && errno == EINTR) continue;
@@ -78,17 +97,30 @@ void ProcessManager::trySendPendingInput(Process& process, server::EpollManager&
 		detachStdin(process, epollManager);
 		return;
 	}
-	detachStdin(process, epollManager);
+	if (process.inputOpen)
+		armStdin(process, false, epollManager);
+	else
+		detachStdin(process, epollManager);
 }
 
 void ProcessManager::handleStdoutEvent(Process& process, uint32_t events,
 									   server::EpollManager& epollManager) {
-	if (events & EPOLLIN) {
-		char buffer[4096];
-		while (true) {
-			ssize_t n = read(process.stdoutFd, buffer, sizeof(buffer));
+	if (process.stdoutSpliced) return;
+
+	// Reads are bounded per event so one chatty script cannot fill memory ahead of its client;
+	// re-arming the edge-triggered registration picks up whatever is left. A script that has
+	// hung up is drained whole, even while paused, since the socket buffer bounds the rest.
+	bool hangup = events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+	if (hangup || ((events & EPOLLIN) && !process.stdoutPaused)) {
+		std::vector<unsigned char>& buffer = process.relay.buffer;
+		size_t budget = kStdoutReadBudget;
+		while (hangup || budget > 0) {
+			size_t used = buffer.size();
+			buffer.resize(used + kStdoutReadSize);
+			ssize_t n = read(process.stdoutFd, &buffer[used], kStdoutReadSize);
+			buffer.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
 			if (n > 0) {
-				process.output.append(buffer, n);
+				budget -= std::min(budget, static_cast<size_t>(n));
 				continue;
 			}
 			if (n == 0) {
@@ -100,8 +132,9 @@ void ProcessManager::handleStdoutEvent(Process& process, uint32_t events,
 			process.stdoutClosed = true;
 			break;
 		}
+		if (!process.stdoutClosed && budget == 0)
+			epollManager.modify(process.stdoutFd, kStdoutEvents);
 	}
-	if (events & EPOLLRDHUP) process.stdoutClosed = true;
 	if (process.stdoutClosed) detachStdout(process, epollManager);
 }
 
@@ -116,26 +149,193 @@ void ProcessManager::handleCgiEvent(int fd, uint32_t events, server::EpollManage
 	if (stdinIt == _stdinToStdout.end()) return;
 	std::map<int, Process>::iterator procIt = _processes.find(stdinIt->second);
 	if (procIt == _processes.end()) return;
-	if (events & EPOLLOUT) trySendPendingInput(procIt->second, epollManager);
+	if (events & (EPOLLERR | EPOLLHUP))
+		detachStdin(procIt->second, epollManager);
+	else if (events & EPOLLOUT)
+		trySendPendingInput(procIt->second, epollManager);
+}
+
+// Starts a registered script, handing it the child ends of its socketpairs. They are closed
+// here either way, so a script that failed to start reads as one that failed without output.
+// The script holds its process slot until its pidfd reports it has exited.
+bool ProcessManager::spawn(Process& process, server::EpollManager& epollManager) {
+	std::map<int, Launch>::iterator it = _launches.find(process.stdoutFd);
+	if (it == _launches.end()) return false;
+	Launch& launch = it->second;
+
+	int input = launch.body.isOpen() ? launch.body.getFd() : launch.childStdin;
+	pid_t pid = Executor::spawn(launch.argv, launch.env, input, launch.childStdout,
+								launch.childStdout, launch.cpuLimit, launch.memoryLimit);
+	int pidfd = pid == -1 ? -1 : Executor::watch(pid);
+	long killDelay = launch.killDelay;
+	closeFdQuiet(launch.childStdin);
+	closeFdQuiet(launch.childStdout);
+	_launches.erase(it);
+	if (pidfd == -1) {
+		process.exited = true;
+		process.relay.failed = true;
+		return false;
+	}
+
+	epollManager.add(pidfd, EPOLLIN);
+	Child& child = _children[pidfd];
+	child.pid = pid;
+	child.stdoutFd = process.stdoutFd;
+	child.killDelay = killDelay;
+	process.pidfd = pidfd;
+	process.running = true;
+	++_running;
+	return true;
+}
+
+// Starts waiting scripts in arrival order while cgi_max_processes allows.
+void ProcessManager::spawnWaiting(server::EpollManager& epollManager) {
+	while (!_waiting.empty() && (_maxProcesses == 0 || _running < _maxProcesses)) {
+		std::map<int, Process>::iterator it = _processes.find(_waiting.front());
+		_waiting.pop_front();
+		if (it != _processes.end()) spawn(it->second, epollManager);
+	}
 }
 
-void ProcessManager::registerProcess(pid_t pid, int stdoutFd, int stdinFd, int clientFd,
-									 const std::string& body, server::EpollManager& epollManager) {
-	Process process(pid, stdoutFd, stdinFd, clientFd, body);
+void ProcessManager::discardLaunch(int stdoutFd) {
+	std::map<int, Launch>::iterator it = _launches.find(stdoutFd);
+	if (it == _launches.end()) return;
+	closeFdQuiet(it->second.childStdin);
+	closeFdQuiet(it->second.childStdout);
+	_launches.erase(it);
+	std::deque<int>::iterator waiting = std::find(_waiting.begin(), _waiting.end(), stdoutFd);
+	if (waiting != _waiting.end()) _waiting.erase(waiting);
+}
+
+// cgi_kill_timeout differs between locations, so the deadline is inserted in order.
+void ProcessManager::terminate(int pidfd) {
+	long delay = _children[pidfd].killDelay;
+	if (delay <= 0) {
+		Executor::sendSignal(pidfd, SIGKILL);
+		return;
+	}
+	Executor::sendSignal(pidfd, SIGTERM);
+	std::pair<int, unsigned long long> entry(pidfd, server::TimerWheel::now() + delay);
+	std::deque<std::pair<int, unsigned long long> >::iterator pos = _terminating.end();
+	while (pos != _terminating.begin() && entry.second < (pos - 1)->second) --pos;
+	_terminating.insert(pos, entry);
+}
+
+// A script's pidfd has reported its exit: the script is collected, its slot goes to the next
+// waiting one, and its request completes once its output has ended too. A crash or a non-zero
+// exit status marks the relay failed. The client to resume is added to `clients`.
+void ProcessManager::reap(int pidfd, server::EpollManager& epollManager,
+						  std::vector<int>& clients) {
+	std::map<int, Child>::iterator it = _children.find(pidfd);
+	if (it == _children.end()) return;
+	int status = 0;
+	if (!Executor::reap(it->second.pid, status)) return;
+
+	int stdoutFd = it->second.stdoutFd;
+	_children.erase(it);
+	epollManager.remove(pidfd);
+	// The pidfd's number may be handed out again, so a pending SIGKILL must not outlive it.
+	for (std::deque<std::pair<int, unsigned long long> >::iterator term = _terminating.begin();
+		 term != _terminating.end(); ++term) {
+		if (term->first != pidfd) continue;
+		_terminating.erase(term);
+		break;
+	}
+	--_running;
+
+	std::map<int, Process>::iterator procIt = _processes.find(stdoutFd);
+	if (stdoutFd != -1 && procIt != _processes.end()) {
+		Process& process = procIt->second;
+		process.pidfd = -1;
+		process.running = false;
+		process.exited = true;
+		process.completed = process.stdoutClosed;
+		process.relay.failed = WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status));
+		clients.push_back(process.clientFd);
+	}
+	spawnWaiting(epollManager);
+}
+
+void ProcessManager::setMaxProcesses(size_t maxProcesses) {
+	_maxProcesses = maxProcesses;
+}
+
+// The request's I/O starts right away even when every process slot is taken: the script's
+// end of each socketpair simply buffers until the script is started. Returns false when it
+// cannot be started now.
+bool ProcessManager::registerProcess(const Launch& launch, int stdoutFd, int stdinFd, int clientFd,
+									 const std::string& body, bool streaming,
+									 server::EpollManager& epollManager) {
+	Process process(-1, stdoutFd, stdinFd, clientFd, body, streaming);
 	_processes[stdoutFd] = process;
 	_clientToStdout[clientFd] = stdoutFd;
 	if (stdinFd >= 0) _stdinToStdout[stdinFd] = stdoutFd;
+	_launches[stdoutFd] = launch;
 
 	epollManager.add(stdoutFd, kStdoutEvents);
 	Process& stored = _processes[stdoutFd];
 	stored.stdoutRegistered = true;
+	if (_maxProcesses > 0 && _running >= _maxProcesses) {
+		_waiting.push_back(stdoutFd);
+	} else if (!spawn(stored, epollManager)) {
+		release(clientFd, epollManager);
+		return false;
+	}
 	if (!stored.input.empty())
 		trySendPendingInput(stored, epollManager);
-	else
+	else if (!streaming)
 		detachStdin(stored, epollManager);
+	return true;
+}
+
+int ProcessManager::nextTimeout(unsigned long long now) const {
+	if (_terminating.empty()) return -1;
+	unsigned long long deadline = _terminating.front().second;
+	return deadline <= now ? 0 : static_cast<int>(deadline - now);
 }
 
-void ProcessManager::removeCgiProcess(int clientFd, server::EpollManager& epollManager) {
+// SIGKILLs scripts that outlived their SIGTERM. Reaping a script drops its entry, so every
+// pidfd still listed belongs to the script it was opened for.
+void ProcessManager::expire(unsigned long long now) {
+	while (!_terminating.empty() && _terminating.front().second <= now) {
+		int pidfd = _terminating.front().first;
+		_terminating.pop_front();
+		Executor::sendSignal(pidfd, SIGKILL);
+	}
+}
+
+// Streamed request bodies are written straight from the caller's buffer. Returns how much was
+// taken; a short count means stdin is full and will report EPOLLOUT once it drains. Once the
+// script has stopped reading, everything is taken and dropped.
+size_t ProcessManager::writeInput(int clientFd, const char* data, size_t length,
+								  server::EpollManager& epollManager) {
+	Process* process = findByClient(clientFd);
+	if (!process || process->stdinFd < 0) return length;
+
+	size_t offset = 0;
+	while (offset < length) {
+		ssize_t written = write(process->stdinFd, data + offset, length - offset);
+		if (written > 0) {
+			offset += static_cast<size_t>(written);
+			continue;
+		}
+		if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			armStdin(*process, true, epollManager);
+			return offset;
+		}
+		if (written == -1 && errno == EINTR) continue;
+		detachStdin(*process, epollManager);
+		return length;
+	}
+	return offset;
+}
+
+void ProcessManager::finishInput(int clientFd, server::EpollManager& epollManager) {
+	Process* process = findByClient(clientFd);
+	if (process) detachStdin(*process, epollManager);
+}
+
+void ProcessManager::release(int clientFd, server::EpollManager& epollManager) {
 	std::map<int, int>::iterator it = _clientToStdout.find(clientFd);
 	if (it == _clientToStdout.end()) return;
 	int stdoutFd = it->second;
@@ -145,6 +345,13 @@ void ProcessManager::removeCgiProcess(int clientFd, server::EpollManager& epollM
 	if (procIt == _processes.end()) return;
 	Process& process = procIt->second;
 
+	// A script dropped before it finished is asked to stop; one whose output was handed to
+	// the splice relay has written everything it promised. Either is still reaped later.
+	if (process.running) {
+		_children[process.pidfd].stdoutFd = -1;
+		if (!process.stdoutClosed && !process.stdoutSpliced) terminate(process.pidfd);
+	}
+	discardLaunch(stdoutFd);
 	detachStdin(process, epollManager);
 	detachStdout(process, epollManager);
 	_processes.erase(procIt);
@@ -161,12 +368,31 @@ int ProcessManager::getClientFd(int fd) const {
 	return -1;
 }
 
-std::string ProcessManager::getResponse(int stdoutFd) {
-	std::map<int, Process>::iterator procIt = _processes.find(stdoutFd);
-	if (procIt == _processes.end()) throw handler::Exception();
-	std::string output = procIt->second.output;
-	if (output.empty()) throw handler::Exception();
-	return output;
+// Stops reading the script's output while the client is not keeping up with it.
+void ProcessManager::pauseOutput(int clientFd, bool paused, server::EpollManager& epollManager) {
+	Process* process = findByClient(clientFd);
+	if (!process || !process->stdoutRegistered || process->stdoutPaused == paused) return;
+	process->stdoutPaused = paused;
+	unsigned int pausedEvents = process->stdoutSpliced ? kIdleStdoutEvents : kPausedStdoutEvents;
+	epollManager.modify(process->stdoutFd, paused ? pausedEvents : kStdoutEvents);
+}
+
+bool ProcessManager::canSplice() const {
+	return true;
+}
+
+// Hands the rest of the script's output to the client's output queue, which pulls it with
+// splice(); from here on stdout events only wake the relay and are not read.
+int ProcessManager::spliceOutput(int clientFd) {
+	Process* process = findByClient(clientFd);
+	if (!process || process->stdoutFd < 0) return -1;
+	process->stdoutSpliced = true;
+	return process->stdoutFd;
+}
+
+Responder::Relay* ProcessManager::relayOf(int clientFd) {
+	Process* process = findByClient(clientFd);
+	return process ? &process->relay : NULL;
 }
 
 bool ProcessManager::isCgiProcess(int fd) const {
@@ -174,6 +400,10 @@ bool ProcessManager::isCgiProcess(int fd) const {
 	return _stdinToStdout.find(fd) != _stdinToStdout.end();
 }
 
+bool ProcessManager::isChild(int fd) const {
+	return _children.find(fd) != _children.end();
+}
+
 bool ProcessManager::isProcessing(int clientFd) const {
 	return _clientToStdout.find(clientFd) != _clientToStdout.end();
 }
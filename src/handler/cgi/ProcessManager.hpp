@@ -6,79 +6,160 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <deque>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "../../http/model/FileRegion.hpp"
 #include "../../http/model/Packet.hpp"
 #include "../../server/epoll/manager/EpollManager.hpp"
 #include "../exception/Exception.hpp"
+#include "Backend.hpp"
+#include "Responder.hpp"
 
 namespace handler {
 	namespace cgi {
-		class ProcessManager {
+		class ProcessManager : public IBackend {
+			public:
+				// What it takes to start a script once a process slot is free. The child ends
+				// of its socketpairs are held until then, so the request's I/O can begin at
+				// once; a spooled body replaces childStdin as the script's stdin.
+				struct Launch {
+						std::vector<std::string> argv;
+						std::vector<std::string> env;
+						http::FileRegion body;
+						int childStdin;
+						int childStdout;
+						long cpuLimit;
+						long long memoryLimit;
+						long killDelay;
+
+						Launch() :
+							childStdin(-1),
+							childStdout(-1),
+							cpuLimit(0),
+							memoryLimit(0),
+							killDelay(0) {}
+				};
+
 			private:
 				struct Process {
-						pid_t pid;
+						int pidfd;
 						int stdoutFd;
 						int stdinFd;
 						int clientFd;
-						std::string output;
+						Responder::Relay relay;
 						std::string input;
 						size_t inputOffset;
 						bool stdoutClosed;
+						bool inputOpen;
 						bool stdinRegistered;
+						bool stdinArmed;
 						bool stdoutRegistered;
+						bool stdoutPaused;
+						bool stdoutSpliced;
+						bool exited;
 						bool completed;
+						bool running;
 
 						Process() :
-							pid(-1),
+							pidfd(-1),
 							stdoutFd(-1),
 							stdinFd(-1),
 							clientFd(-1),
 							inputOffset(0),
 							stdoutClosed(false),
+							inputOpen(false),
 							stdinRegistered(false),
+							stdinArmed(false),
 							stdoutRegistered(false),
-							completed(false) {}
+							stdoutPaused(false),
+							stdoutSpliced(false),
+							exited(false),
+							completed(false),
+							running(false) {}
 
-						Process(pid_t p, int outFd, int inFd, int clFd, const std::string& body) :
-							pid(p),
+						Process(int pidFd, int outFd, int inFd, int clFd, const std::string& body,
+								bool streaming) :
+							pidfd(pidFd),
 							stdoutFd(outFd),
 							stdinFd(inFd),
 							clientFd(clFd),
 							input(body),
 							inputOffset(0),
 							stdoutClosed(false),
+							inputOpen(streaming),
 							stdinRegistered(false),
+							stdinArmed(false),
 							stdoutRegistered(false),
-							completed(false) {}
+							stdoutPaused(false),
+							stdoutSpliced(false),
+							exited(false),
+							completed(false),
+							running(false) {}
+				};
+
+				// A started script until it is reaped; stdoutFd is -1 once its request is gone.
+				// killDelay is the ms between SIGTERM and SIGKILL when it is dropped.
+				struct Child {
+						pid_t pid;
+						int stdoutFd;
+						long killDelay;
+
+						Child() : pid(-1), stdoutFd(-1), killDelay(0) {}
 				};
 
 				std::map<int, Process> _processes;
 				std::map<int, int> _stdinToStdout;
 				std::map<int, int> _clientToStdout;
+				// Keyed by stdout fd, for processes still waiting in _waiting for a slot.
+				std::map<int, Launch> _launches;
+				std::deque<int> _waiting;
+				// Keyed by pidfd.
+				std::map<int, Child> _children;
+				size_t _running;
+				size_t _maxProcesses;
+				// Pidfds of scripts sent SIGTERM, with the time they are sent SIGKILL if still around,
+				// soonest first.
+				std::deque<std::pair<int, unsigned long long> > _terminating;
 
 				void closeFdQuiet(int);
 				void detachStdout(Process&, server::EpollManager&);
 				void detachStdin(Process&, server::EpollManager&);
+				void armStdin(Process&, bool, server::EpollManager&);
+				Process* findByClient(int);
 				void trySendPendingInput(Process&, server::EpollManager&);
 				void handleStdoutEvent(Process&, uint32_t, server::EpollManager&);
+				bool spawn(Process&, server::EpollManager&);
+				void spawnWaiting(server::EpollManager&);
+				void discardLaunch(int);
+				void terminate(int);
 
 			public:
-				ProcessManager() {}
+				ProcessManager() : _running(0), _maxProcesses(0) {}
 				~ProcessManager() {}
 
-				static void sigchldHandler(int);
-
 				void handleCgiEvent(int, uint32_t, server::EpollManager&);
-				void registerProcess(pid_t, int, int, int, const std::string&,
+				void reap(int, server::EpollManager&, std::vector<int>&);
+				void setMaxProcesses(size_t);
+				bool registerProcess(const Launch&, int, int, int, const std::string&, bool,
 									 server::EpollManager&);
-				void removeCgiProcess(int, server::EpollManager&);
+				int nextTimeout(unsigned long long) const;
+				void expire(unsigned long long);
+				virtual size_t writeInput(int, const char*, size_t, server::EpollManager&);
+				virtual void finishInput(int, server::EpollManager&);
+				virtual void pauseOutput(int, bool, server::EpollManager&);
+				virtual bool canSplice() const;
+				virtual int spliceOutput(int);
+				virtual Responder::Relay* relayOf(int);
+				virtual void release(int, server::EpollManager&);
+				virtual bool isProcessing(int) const;
+				virtual bool isCompleted(int) const;
 				int getClientFd(int) const;
-				std::string getResponse(int);
 				bool isCgiProcess(int) const;
-				bool isProcessing(int) const;
-				bool isCompleted(int) const;
+				bool isChild(int) const;
 		};
 	}  // namespace cgi
 }  // namespace handler
@@ -1,69 +1,96 @@
 #include "Responder.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
 using namespace handler::cgi;
 
-Responder::CgiOutput Responder::parseCgiOutput(const std::string& cgiResult) {
-	CgiOutput output;
+static bool findContentLength(const std::string& header, unsigned long long& length) {
+	std::istringstream lines(header);
+	std::string line;
 
-	size_t headerEnd = cgiResult.find("\r\n\r\n");
-	if (headerEnd == std::string::npos) {
-		output.error = CgiOutput::INVALID_FORMAT;
-		return output;
+	while (std::getline(lines, line)) {
+		size_t colon = line.find(':');
+		if (colon == std::string::npos || to_lower(line.substr(0, colon)) != "content-length")
+			continue;
+		size_t first = line.find_first_not_of(" \t", colon + 1);
+		size_t last = line.find_last_not_of(" \t\r");
+		if (first == std::string::npos || last < first) throw handler::Exception();
+		std::string value = line.substr(first, last - first + 1);
+		if (value.find_first_not_of("0123456789") != std::string::npos) throw handler::Exception();
+		length = std::strtoull(value.c_str(), NULL, 10);
+		return true;
 	}
+	return false;
+}
 
-	std::string httpHeader = cgiResult.substr(0, headerEnd);
-	std::string body = cgiResult.substr(headerEnd + 4);
+// Turns the script's header block into a response head as soon as it is complete, and
+// settles the body framing: the script's own Content-Length is passed through, otherwise the
+// body is chunked, or delimited by closing the connection for HTTP/1.0 clients.
+bool Responder::makeHead(Relay& relay, bool& keepAlive, std::string& head) {
+	static const char kHeaderEnd[] = "\r\n\r\n";
+	std::vector<unsigned char>::iterator end =
+		std::search(relay.buffer.begin(), relay.buffer.end(), kHeaderEnd, kHeaderEnd + 4);
+	if (end == relay.buffer.end()) return false;
 
-	size_t statusPos = httpHeader.find("Status: ");
-	if (statusPos != 0) {
-		output.error = CgiOutput::INVALID_FORMAT;
-		return output;
-	}
+	std::string httpHeader(relay.buffer.begin(), end);
+	relay.buffer.erase(relay.buffer.begin(), end + 4);
 
-	size_t contentTypePos = httpHeader.find("\r\nContent-Type: ");
-	if (contentTypePos == std::string::npos) {
-		output.error = CgiOutput::INVALID_FORMAT;
-		return output;
-	}
+	if (httpHeader.find("Status: ") != 0 ||
+		httpHeader.find("\r\nContent-Type: ") == std::string::npos)
+		throw handler::Exception();
 
 	size_t lineEnd = httpHeader.find("\r\n", 0);
 	std::string statusStr = httpHeader.substr(8, lineEnd - 8);
 	http::StatusCode::Value statusCode = static_cast<http::StatusCode::Value>(str_toint(statusStr));
 	std::string statusMessage = http::StatusCode::to_reasonPhrase(statusCode);
-	if (statusMessage == "Unknown Status") {
-		output.error = CgiOutput::INVALID_FORMAT;
-		return output;
+	if (statusMessage == "Unknown Status") throw handler::Exception();
+	httpHeader.erase(0, lineEnd + 2);
+
+	if (findContentLength(httpHeader, relay.remaining)) {
+		relay.framing = Relay::Length;
+	} else if (relay.allowChunked) {
+		relay.framing = Relay::Chunked;
+		httpHeader += "\r\nTransfer-Encoding: chunked";
+	} else {
+		relay.framing = Relay::UntilClose;
+		keepAlive = false;
 	}
 
-	output.statusCode = statusCode;
-	output.httpHeader = httpHeader;
-	output.body = body;
-	output.error = CgiOutput::NONE;
-	return output;
+	head = "HTTP/1.1 " + int_tostr(statusCode) + " " + statusMessage + "\r\n" + httpHeader +
+		   "\r\nServer: webserv\r\nConnection: " + (keepAlive ? "keep-alive" : "close") +
+		   "\r\n\r\n";
+	return true;
 }
 
-std::string Responder::makeCgiResponse(const std::string& cgiResult) {
-	CgiOutput cgiOutput = Responder::parseCgiOutput(cgiResult);
-	std::string httpHeader = cgiOutput.httpHeader;
-	std::string body = cgiOutput.body;
-	http::StatusCode::Value statusCode = cgiOutput.statusCode;
+// Hands over everything buffered as the next piece of body; the bytes move, they are not copied.
+void Responder::takeBody(Relay& relay, std::string& prefix, std::vector<unsigned char>& body) {
+	if (relay.buffer.empty()) return;
 
-	if (cgiOutput.error == CgiOutput::INVALID_FORMAT) {
-		throw handler::Exception();
+	if (relay.framing == Relay::Length) {
+		if (relay.buffer.size() > relay.remaining) relay.buffer.resize(relay.remaining);
+		relay.remaining -= relay.buffer.size();
+	} else if (relay.framing == Relay::Chunked) {
+		std::ostringstream size;
+		size << (relay.chunkOpen ? "\r\n" : "") << std::hex << relay.buffer.size() << "\r\n";
+		prefix = size.str();
+		relay.chunkOpen = true;
 	}
+	body.swap(relay.buffer);
+}
 
-	size_t lineEnd = httpHeader.find("\r\n", 0);
-	httpHeader.erase(0, lineEnd + 2);
-
-	std::string statusLine = "HTTP/1.1 " + int_tostr(statusCode) + " " +
-							 http::StatusCode::to_reasonPhrase(statusCode) + "\r\n";
-
-	httpHeader +=
-		("\r\n"
-		 "Content-Length: " +
-		 int_tostr(body.size()) +
-		 "\r\n"
-		 "Server: webserv\r\n");
-
-	return statusLine + httpHeader + "\r\n" + body;
+// What follows the last body byte. A body cut short of its Content-Length, or by a script that
+// failed, can only be reported by closing the connection; a chunked one then never gets its
+// last chunk.
+std::string Responder::finish(Relay& relay, bool& keepAlive) {
+	if (relay.failed) {
+		keepAlive = false;
+		return std::string();
+	}
+	if (relay.framing == Relay::Chunked) return relay.chunkOpen ? "\r\n0\r\n\r\n" : "0\r\n\r\n";
+	if (relay.framing == Relay::UntilClose ||
+		(relay.framing == Relay::Length && relay.remaining > 0))
+		keepAlive = false;
+	return std::string();
 }
@@ -3,6 +3,7 @@
 #define HANDLER_CGI_RESPONDER_HPP
 
 #include <string>
+#include <vector>
 
 #include "../../http/Enums.hpp"
 #include "../../utils/str_utils.hpp"
@@ -11,28 +12,40 @@
 namespace handler {
 	namespace cgi {
 		class Responder {
-			private:
-				struct CgiOutput {
-						std::string httpHeader;
-						std::string body;
-						http::StatusCode::Value statusCode;
-						enum error {
-							NONE,
-							INVALID_FORMAT,
-						} error;
-						CgiOutput() :
-							httpHeader(""),
-							body(""),
-							statusCode(http::StatusCode::UnknownStatus),
-							error(NONE) {}
+			public:
+				// A CGI response on its way to the client: output not relayed yet, and once the
+				// header block has become a response head, how the body is framed on the wire.
+				// `failed` is set by a backend whose script crashed or exited non-zero.
+				struct Relay {
+						enum Framing {
+							Head,
+							Length,
+							Chunked,
+							UntilClose,
+							Spliced
+						} framing;
+						std::vector<unsigned char> buffer;
+						bool allowChunked;
+						bool chunkOpen;
+						bool failed;
+						unsigned long long remaining;
+
+						Relay() :
+							framing(Head),
+							allowChunked(true),
+							chunkOpen(false),
+							failed(false),
+							remaining(0) {}
 				};
 
+			private:
 				Responder() {}
 				~Responder() {}
-				static CgiOutput parseCgiOutput(const std::string& cgiResult);
 
 			public:
-				static std::string makeCgiResponse(const std::string&);
+				static bool makeHead(Relay&, bool&, std::string&);
+				static void takeBody(Relay&, std::string&, std::vector<unsigned char>&);
+				static std::string finish(Relay&, bool&);
 		};
 	}  // namespace cgi
 }  // namespace handler
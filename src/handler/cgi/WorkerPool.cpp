@@ -0,0 +1,534 @@
+// WorkerPool.cpp
+#include "WorkerPool.hpp"
+
+#include <limits.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+
+#include "Executor.hpp"
+
+using namespace handler::cgi;
+
+namespace {
+	const size_t kFrameHeader = 4;
+	const size_t kFrameSize = 32 * 1024;
+	const size_t kMaxFrame = 16 * 1024 * 1024;
+	const size_t kWriteWater = 64 * 1024;
+	const size_t kReadSize = 16 * 1024;
+	const size_t kReadBudget = 256 * 1024;
+
+	const char kBootstrapName[] = "pool_worker.py";
+
+	void appendFrame(std::string& out, const char* data, size_t length) {
+		unsigned char header[kFrameHeader] = {static_cast<unsigned char>((length >> 24) & 0xff),
+											  static_cast<unsigned char>((length >> 16) & 0xff),
+											  static_cast<unsigned char>((length >> 8) & 0xff),
+											  static_cast<unsigned char>(length & 0xff)};
+		out.append(reinterpret_cast<const char*>(header), kFrameHeader);
+		if (length > 0) out.append(data, length);
+	}
+
+	// Data only; the empty frame that ends a stream is appended apart.
+	void appendStream(std::string& out, const char* data, size_t length) {
+		for (size_t offset = 0; offset < length; offset += kFrameSize)
+			appendFrame(out, data + offset, std::min(kFrameSize, length - offset));
+	}
+
+	std::string locateBootstrap() {
+		char exe[PATH_MAX];
+		ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+		if (length <= 0) return std::string();
+		std::string path(exe, static_cast<size_t>(length));
+		path = path.substr(0, path.rfind('/') + 1) + kBootstrapName;
+		return access(path.c_str(), R_OK) == 0 ? path : std::string();
+	}
+
+	void wake(std::vector<int>& clients, int clientFd) {
+		if (std::find(clients.begin(), clients.end(), clientFd) == clients.end())
+			clients.push_back(clientFd);
+	}
+}
+
+// Workers exit on their own once their socket closes.
+WorkerPool::~WorkerPool() {
+	for (std::map<int, Worker>::iterator it = _workers.begin(); it != _workers.end(); ++it)
+		close(it->first);
+	for (std::map<int, pid_t>::iterator it = _exits.begin(); it != _exits.end(); ++it) {
+		Executor::unwatch(it->first);
+		close(it->first);
+	}
+}
+
+bool WorkerPool::spawn(const PoolKey& key, server::EpollManager& epollManager) {
+	int fd = -1;
+	if (_maxProcesses > 0 && _workers.size() >= _maxProcesses) return false;
+	Executor executor;
+	pid_t pid = executor.spawnWorker(bootstrap(), key.second, fd);
+	if (pid == -1) return false;
+	int pidfd = Executor::watch(pid);
+	if (pidfd == -1) {
+		close(fd);
+		return false;
+	}
+	epollManager.add(pidfd, EPOLLIN);
+	_exits[pidfd] = pid;
+
+	Worker& worker = _workers[fd];
+	worker.pidfd = pidfd;
+	worker.fd = fd;
+	worker.pool = key;
+	worker.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	epollManager.add(fd, worker.events);
+	_pools[key].workers++;
+	return true;
+}
+
+WorkerPool::Worker* WorkerPool::idleWorker(const PoolKey& key) {
+	for (std::map<int, Worker>::iterator it = _workers.begin(); it != _workers.end(); ++it) {
+		if (it->second.clientFd == -1 && it->second.pool == key) return &it->second;
+	}
+	return NULL;
+}
+
+WorkerPool::Request* WorkerPool::findRequest(int clientFd) {
+	std::map<int, Request>::iterator it = _requests.find(clientFd);
+	return it == _requests.end() ? NULL : &it->second;
+}
+
+const WorkerPool::Request* WorkerPool::findRequest(int clientFd) const {
+	std::map<int, Request>::const_iterator it = _requests.find(clientFd);
+	return it == _requests.end() ? NULL : &it->second;
+}
+
+// Hands queued requests to idle workers in arrival order, starting workers up to the pool's
+// size when none is idle.
+void WorkerPool::dispatch(const PoolKey& key, server::EpollManager& epollManager) {
+	Pool& pool = _pools[key];
+	while (!pool.queue.empty()) {
+		Worker* worker = idleWorker(key);
+		if (!worker) {
+			if (pool.workers >= pool.size || !spawn(key, epollManager)) return;
+			continue;
+		}
+		int clientFd = pool.queue.front();
+		pool.queue.pop_front();
+		assign(*worker, clientFd, epollManager);
+	}
+}
+
+void WorkerPool::assign(Worker& worker, int clientFd, server::EpollManager& epollManager) {
+	Request& request = _requests[clientFd];
+	worker.clientFd = clientFd;
+	worker.paused = request.paused;
+	request.workerFd = worker.fd;
+	worker.output.append(request.prologue);
+	std::string().swap(request.prologue);
+	feedBody(worker);
+	updateEvents(worker, epollManager);
+}
+
+// A spooled request body is read from its file as the worker drains, so only about
+// kWriteWater of it is held in memory at a time.
+void WorkerPool::feedBody(Worker& worker) {
+	Request* request = worker.clientFd == -1 ? NULL : findRequest(worker.clientFd);
+	char buffer[kFrameSize];
+
+	while (request && request->body.isOpen() &&
+		   worker.output.size() - worker.outputOffset < kWriteWater) {
+		const http::FileRegion& body = request->body;
+		size_t left = body.getLength() - request->bodySent;
+		ssize_t got = 0;
+		if (left > 0)
+			got = pread(body.getFd(), buffer, std::min(left, kFrameSize),
+						body.getOffset() + static_cast<off_t>(request->bodySent));
+		if (got > 0) {
+			appendFrame(worker.output, buffer, static_cast<size_t>(got));
+			request->bodySent += static_cast<size_t>(got);
+			continue;
+		}
+		if (got == -1 && errno == EINTR) continue;
+		appendFrame(worker.output, NULL, 0);
+		request->inputOpen = false;
+		request->body = http::FileRegion();
+	}
+}
+
+bool WorkerPool::flush(Worker& worker, std::vector<int>& clients) {
+	bool blocked = false;
+
+	while (!blocked) {
+		while (worker.outputOffset < worker.output.size()) {
+			ssize_t written = write(worker.fd, worker.output.data() + worker.outputOffset,
+									worker.output.size() - worker.outputOffset);
+			if (written > 0) {
+				worker.outputOffset += static_cast<size_t>(written);
+				continue;
+			}
+			if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				blocked = true;
+				break;
+			}
+			if (written == -1 && errno == EINTR) continue;
+			return false;
+		}
+		if (blocked) break;
+		worker.output.clear();
+		worker.outputOffset = 0;
+		feedBody(worker);
+		if (worker.output.empty()) break;
+	}
+	if (worker.outputOffset >= kWriteWater) {
+		worker.output.erase(0, worker.outputOffset);
+		worker.outputOffset = 0;
+	}
+
+	Request* request = worker.clientFd == -1 ? NULL : findRequest(worker.clientFd);
+	if (request && request->inputBlocked &&
+		worker.output.size() - worker.outputOffset < kWriteWater) {
+		request->inputBlocked = false;
+		wake(clients, worker.clientFd);
+	}
+	return true;
+}
+
+// Reads are bounded per event and stop while the worker's client is behind; a worker that hung
+// up is drained whole. Returns false once the worker is unusable.
+bool WorkerPool::receive(Worker& worker, uint32_t events, server::EpollManager& epollManager,
+						 std::vector<int>& clients) {
+	bool hangup = events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+	if (!hangup && (!(events & EPOLLIN) || worker.paused)) return true;
+
+	std::vector<unsigned char>& buffer = worker.input;
+	size_t budget = kReadBudget;
+	bool open = true;
+	while (hangup || budget > 0) {
+		size_t used = buffer.size();
+		buffer.resize(used + kReadSize);
+		ssize_t n = read(worker.fd, &buffer[used], kReadSize);
+		buffer.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
+		if (n > 0) {
+			budget -= std::min(budget, static_cast<size_t>(n));
+			continue;
+		}
+		if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		if (n == -1 && errno == EINTR) continue;
+		open = false;
+		break;
+	}
+	if (!parseFrames(worker, clients)) return false;
+	if (open && budget == 0) epollManager.modify(worker.fd, worker.events);
+	return open;
+}
+
+bool WorkerPool::parseFrames(Worker& worker, std::vector<int>& clients) {
+	std::vector<unsigned char>& input = worker.input;
+	size_t offset = 0;
+
+	while (input.size() - offset >= kFrameHeader) {
+		const unsigned char* header = &input[offset];
+		size_t length = (static_cast<size_t>(header[0]) << 24) |
+						(static_cast<size_t>(header[1]) << 16) |
+						(static_cast<size_t>(header[2]) << 8) | header[3];
+		if (length > kMaxFrame) return false;
+		if (input.size() - offset - kFrameHeader < length) break;
+
+		Request* request = worker.clientFd == -1 ? NULL : findRequest(worker.clientFd);
+		bool open = request && !request->completed;
+		const unsigned char* content = header + kFrameHeader;
+		if (worker.ending) {
+			// The script's wait status, judged as ProcessManager judges a script's exit.
+			if (length != 4) return false;
+			worker.ending = false;
+			if (open) {
+				int status = static_cast<int>((static_cast<unsigned int>(content[0]) << 24) |
+											  (content[1] << 16) | (content[2] << 8) | content[3]);
+				request->completed = true;
+				request->relay.failed =
+					WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status));
+				worker.served++;
+				wake(clients, worker.clientFd);
+			}
+		} else if (length == 0) {
+			worker.ending = true;
+		} else if (open) {
+			request->relay.buffer.insert(request->relay.buffer.end(), content, content + length);
+			wake(clients, worker.clientFd);
+		}
+		offset += kFrameHeader + length;
+	}
+	input.erase(input.begin(), input.begin() + offset);
+	return true;
+}
+
+void WorkerPool::updateEvents(Worker& worker, server::EpollManager& epollManager) {
+	unsigned int events = EPOLLRDHUP | EPOLLET;
+	if (!worker.paused) events |= EPOLLIN;
+	if (worker.outputOffset < worker.output.size()) events |= EPOLLOUT;
+	if (events == worker.events) return;
+	epollManager.modify(worker.fd, events);
+	worker.events = events;
+}
+
+void WorkerPool::removeWorker(Worker& worker, server::EpollManager& epollManager) {
+	int fd = worker.fd;
+	_pools[worker.pool].workers--;
+	_workers.erase(fd);
+	epollManager.remove(fd);
+}
+
+// Ends a worker that died or broke the framing, together with its request. One that had served
+// requests is replaced; one that never finished any is taken to mean the interpreter cannot
+// run at all, and the requests queued behind it fail instead of respawning in a loop.
+void WorkerPool::retire(Worker& worker, std::vector<int>& clients,
+						server::EpollManager& epollManager) {
+	PoolKey key = worker.pool;
+	bool healthy = worker.served > 0;
+
+	Request* request = worker.clientFd == -1 ? NULL : findRequest(worker.clientFd);
+	if (request) {
+		request->workerFd = -1;
+		request->completed = true;
+		request->relay.failed = true;
+		request->inputOpen = false;
+		request->inputBlocked = false;
+		request->body = http::FileRegion();
+		wake(clients, worker.clientFd);
+	}
+	Executor::sendSignal(worker.pidfd, SIGKILL);
+	removeWorker(worker, epollManager);
+
+	Pool& pool = _pools[key];
+	if (healthy) {
+		while (pool.workers < pool.size && spawn(key, epollManager)) {
+		}
+		dispatch(key, epollManager);
+		return;
+	}
+	for (size_t i = 0; i < pool.queue.size(); ++i) {
+		Request& queued = _requests[pool.queue[i]];
+		queued.completed = true;
+		queued.inputOpen = false;
+		queued.inputBlocked = false;
+		wake(clients, pool.queue[i]);
+	}
+	pool.queue.clear();
+}
+
+// pool_worker.py next to the running binary, or empty when it is not installed there.
+const std::string& WorkerPool::bootstrap() {
+	static const std::string path = locateBootstrap();
+	return path;
+}
+
+// Whether an interpreter can run the bootstrap: a python one, by the name of its binary, with
+// the bootstrap installed.
+bool WorkerPool::runs(const std::string& interpreter) {
+	size_t slash = interpreter.rfind('/');
+	size_t name = slash == std::string::npos ? 0 : slash + 1;
+	return interpreter.compare(name, 6, "python") == 0 && !bootstrap().empty();
+}
+
+// Workers hold their process slot for as long as they live.
+void WorkerPool::setMaxProcesses(size_t maxProcesses) {
+	_maxProcesses = maxProcesses;
+}
+
+void WorkerPool::warm(const std::string& directory, size_t size, const std::string& interpreter,
+					  server::EpollManager& epollManager) {
+	PoolKey key(directory, interpreter);
+	Pool& pool = _pools[key];
+	pool.size = std::max(pool.size, size);
+	while (pool.workers < pool.size && spawn(key, epollManager)) {
+	}
+}
+
+// Frames the request for the pool of its script directory and interpreter and queues it.
+// Returns false when the pool has no worker and none can be started.
+bool WorkerPool::start(const router::RouteDecision& decision, const http::Packet& request,
+					   const sockaddr_in& peer, int clientFd, bool streamBody,
+					   server::EpollManager& epollManager) {
+	PoolKey key(decision.fsRoot, decision.cgiInterpreter);
+	Pool& pool = _pools[key];
+	pool.size = std::max(pool.size, static_cast<size_t>(decision.cgiPool));
+
+	Request& stored = _requests[clientFd];
+	stored = Request();
+	stored.pool = key;
+
+	std::ostringstream limits;
+	limits << decision.cgiCpuLimit << ' ' << decision.cgiMemoryLimit;
+	appendFrame(stored.prologue, limits.str().data(), limits.str().size());
+
+	std::vector<std::string> env;
+	Executor::buildEnvironment(decision, request, peer, env);
+	std::string block;
+	for (size_t i = 0; i < env.size(); ++i) {
+		block += env[i];
+		block += '\0';
+	}
+	appendFrame(stored.prologue, block.data(), block.size());
+
+	if (!streamBody) {
+		const http::Body& body = request.getBody();
+		bool post = request.getStartLine().method == http::Method::POST;
+		if (post && body.isFileBacked()) {
+			stored.body = body.getFile();
+		} else {
+			const std::vector<unsigned char>& data = body.getData();
+			if (post && !data.empty())
+				appendStream(stored.prologue, reinterpret_cast<const char*>(data.data()),
+							 data.size());
+			appendFrame(stored.prologue, NULL, 0);
+			stored.inputOpen = false;
+		}
+	}
+
+	pool.queue.push_back(clientFd);
+	dispatch(key, epollManager);
+	if (stored.workerFd == -1 && pool.workers == 0) {
+		pool.queue.pop_back();
+		_requests.erase(clientFd);
+		return false;
+	}
+	return true;
+}
+
+void WorkerPool::handleEvent(int fd, uint32_t events, server::EpollManager& epollManager,
+							 std::vector<int>& clients) {
+	// A worker's pidfd. Its socket reports the death to the pool, so here the worker is only
+	// collected, and a worker not retired yet forgets the pidfd before its number is reused.
+	std::map<int, pid_t>::iterator exit = _exits.find(fd);
+	if (exit != _exits.end()) {
+		int status;
+		if (!Executor::reap(exit->second, status)) return;
+		_exits.erase(exit);
+		epollManager.remove(fd);
+		for (std::map<int, Worker>::iterator it = _workers.begin(); it != _workers.end(); ++it) {
+			if (it->second.pidfd == fd) it->second.pidfd = -1;
+		}
+		return;
+	}
+
+	std::map<int, Worker>::iterator it = _workers.find(fd);
+	if (it == _workers.end()) return;
+	Worker& worker = it->second;
+
+	bool usable = true;
+	if (events & EPOLLOUT) usable = flush(worker, clients);
+	if (usable) usable = receive(worker, events, epollManager, clients);
+	if (!usable) {
+		retire(worker, clients, epollManager);
+		return;
+	}
+	updateEvents(worker, epollManager);
+}
+
+bool WorkerPool::isWorker(int fd) const {
+	return _workers.find(fd) != _workers.end() || _exits.find(fd) != _exits.end();
+}
+
+// Streamed request bodies are framed straight onto the worker while it keeps up. A request
+// still waiting for a worker takes nothing; its client is woken once the worker drains.
+size_t WorkerPool::writeInput(int clientFd, const char* data, size_t length,
+							  server::EpollManager& epollManager) {
+	Request* request = findRequest(clientFd);
+	if (!request || !request->inputOpen) return length;
+	if (request->workerFd == -1) {
+		request->inputBlocked = true;
+		return 0;
+	}
+	Worker& worker = _workers[request->workerFd];
+
+	size_t pending = worker.output.size() - worker.outputOffset;
+	size_t taken = pending < kWriteWater ? std::min(length, kWriteWater - pending) : 0;
+	appendStream(worker.output, data, taken);
+	request->inputBlocked = taken < length;
+	updateEvents(worker, epollManager);
+	return taken;
+}
+
+void WorkerPool::finishInput(int clientFd, server::EpollManager& epollManager) {
+	Request* request = findRequest(clientFd);
+	if (!request || !request->inputOpen) return;
+	request->inputOpen = false;
+	if (request->workerFd == -1) {
+		appendFrame(request->prologue, NULL, 0);
+		return;
+	}
+	Worker& worker = _workers[request->workerFd];
+	appendFrame(worker.output, NULL, 0);
+	updateEvents(worker, epollManager);
+}
+
+void WorkerPool::pauseOutput(int clientFd, bool paused, server::EpollManager& epollManager) {
+	Request* request = findRequest(clientFd);
+	if (!request || request->paused == paused) return;
+	request->paused = paused;
+	if (request->workerFd == -1) return;
+	Worker& worker = _workers[request->workerFd];
+	worker.paused = paused;
+	updateEvents(worker, epollManager);
+}
+
+bool WorkerPool::canSplice() const {
+	return false;
+}
+
+int WorkerPool::spliceOutput(int clientFd) {
+	(void) clientFd;
+	return -1;
+}
+
+Responder::Relay* WorkerPool::relayOf(int clientFd) {
+	Request* request = findRequest(clientFd);
+	return request ? &request->relay : NULL;
+}
+
+// A finished request gives its worker back, after ending any stdin the script did not wait
+// for. One dropped mid-run takes its worker down with it, since the script cannot be stopped
+// any other way, and a fresh one is started in its place.
+void WorkerPool::release(int clientFd, server::EpollManager& epollManager) {
+	std::map<int, Request>::iterator it = _requests.find(clientFd);
+	if (it == _requests.end()) return;
+	Request& request = it->second;
+	PoolKey key = request.pool;
+	Pool& pool = _pools[key];
+
+	std::map<int, Worker>::iterator workerIt = _workers.find(request.workerFd);
+	if (workerIt == _workers.end()) {
+		std::deque<int>::iterator queued = std::find(pool.queue.begin(), pool.queue.end(), clientFd);
+		if (queued != pool.queue.end()) pool.queue.erase(queued);
+		_requests.erase(it);
+		return;
+	}
+
+	Worker& worker = workerIt->second;
+	if (request.completed) {
+		if (request.inputOpen) appendFrame(worker.output, NULL, 0);
+		worker.clientFd = -1;
+		worker.paused = false;
+		updateEvents(worker, epollManager);
+	} else {
+		Executor::sendSignal(worker.pidfd, SIGKILL);
+		removeWorker(worker, epollManager);
+		while (pool.workers < pool.size && spawn(key, epollManager)) {
+		}
+	}
+	_requests.erase(it);
+	dispatch(key, epollManager);
+}
+
+bool WorkerPool::isProcessing(int clientFd) const {
+	return findRequest(clientFd) != NULL;
+}
+
+bool WorkerPool::isCompleted(int clientFd) const {
+	const Request* request = findRequest(clientFd);
+	return request && request->completed;
+}
@@ -0,0 +1,141 @@
+// WorkerPool.hpp
+#ifndef HANDLER_CGI_WORKER_POOL_HPP
+#define HANDLER_CGI_WORKER_POOL_HPP
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../http/model/FileRegion.hpp"
+#include "../../http/model/Packet.hpp"
+#include "../../router/model/RouteDecision.hpp"
+#include "../../server/epoll/manager/EpollManager.hpp"
+#include "Backend.hpp"
+#include "Responder.hpp"
+
+namespace handler {
+	namespace cgi {
+		// Keeps cgi_pool python interpreters warm per script directory and interpreter, and runs
+		// one request at a time on each instead of starting a fresh interpreter per request.
+		// Each worker runs pool_worker.py, installed next to the binary, which forks every
+		// script from the warm interpreter; its framing is described there. Requests arriving
+		// while every worker is busy wait in a FIFO queue. Workers count against
+		// cgi_max_processes, and a pool that cannot start any sends its scripts to the
+		// ProcessManager instead.
+		class WorkerPool : public IBackend {
+			private:
+				// Script directory and interpreter.
+				typedef std::pair<std::string, std::string> PoolKey;
+
+				struct Worker {
+						int pidfd;
+						int fd;
+						PoolKey pool;
+						int clientFd;
+						size_t served;
+						std::string output;
+						size_t outputOffset;
+						std::vector<unsigned char> input;
+						// The empty frame has arrived and the status frame is next.
+						bool ending;
+						bool paused;
+						unsigned int events;
+
+						Worker() :
+							pidfd(-1),
+							fd(-1),
+							clientFd(-1),
+							served(0),
+							outputOffset(0),
+							ending(false),
+							paused(false),
+							events(0) {}
+				};
+
+				struct Request {
+						PoolKey pool;
+						int workerFd;
+						Responder::Relay relay;
+						// Frames written before a worker was free to take them.
+						std::string prologue;
+						http::FileRegion body;
+						size_t bodySent;
+						bool inputOpen;
+						bool completed;
+						bool inputBlocked;
+						bool paused;
+
+						Request() :
+							workerFd(-1),
+							bodySent(0),
+							inputOpen(true),
+							completed(false),
+							inputBlocked(false),
+							paused(false) {}
+				};
+
+				struct Pool {
+						size_t size;
+						size_t workers;
+						std::deque<int> queue;
+
+						Pool() : size(0), workers(0) {}
+				};
+
+				std::map<int, Worker> _workers;
+				std::map<int, Request> _requests;
+				std::map<PoolKey, Pool> _pools;
+				// Pidfd to pid of every started worker until it is reaped, which may be after
+				// the worker itself was retired.
+				std::map<int, pid_t> _exits;
+				size_t _maxProcesses;
+
+				WorkerPool(const WorkerPool&);
+				WorkerPool& operator=(const WorkerPool&);
+
+				bool spawn(const PoolKey&, server::EpollManager&);
+				Worker* idleWorker(const PoolKey&);
+				Request* findRequest(int);
+				const Request* findRequest(int) const;
+				void dispatch(const PoolKey&, server::EpollManager&);
+				void assign(Worker&, int, server::EpollManager&);
+				void feedBody(Worker&);
+				bool flush(Worker&, std::vector<int>&);
+				bool receive(Worker&, uint32_t, server::EpollManager&, std::vector<int>&);
+				bool parseFrames(Worker&, std::vector<int>&);
+				void updateEvents(Worker&, server::EpollManager&);
+				void removeWorker(Worker&, server::EpollManager&);
+				void retire(Worker&, std::vector<int>&, server::EpollManager&);
+
+			public:
+				WorkerPool() : _maxProcesses(0) {}
+				~WorkerPool();
+
+				static const std::string& bootstrap();
+				static bool runs(const std::string&);
+				void setMaxProcesses(size_t);
+				void warm(const std::string&, size_t, const std::string&, server::EpollManager&);
+				bool start(const router::RouteDecision&, const http::Packet&, const sockaddr_in&, int,
+						   bool, server::EpollManager&);
+				void handleEvent(int, uint32_t, server::EpollManager&, std::vector<int>&);
+				bool isWorker(int) const;
+				virtual size_t writeInput(int, const char*, size_t, server::EpollManager&);
+				virtual void finishInput(int, server::EpollManager&);
+				virtual void pauseOutput(int, bool, server::EpollManager&);
+				virtual bool canSplice() const;
+				virtual int spliceOutput(int);
+				virtual Responder::Relay* relayOf(int);
+				virtual void release(int, server::EpollManager&);
+				virtual bool isProcessing(int) const;
+				virtual bool isCompleted(int) const;
+		};
+	}  // namespace cgi
+}  // namespace handler
+
+#endif
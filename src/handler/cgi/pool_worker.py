@@ -0,0 +1,162 @@
+"""cgi_pool worker, installed next to the webserv binary.
+
+Started once per pool slot as `python3 pool_worker.py`, with its stdin and stdout both the
+server's socket. The interpreter is started once and each request's script runs in a child
+forked from it, so nothing a script does to modules, globals, os.environ, sys.path or the
+process itself outlives its request, and a crash, sys.exit() or os._exit() ends only the
+child.
+
+Both directions are length-prefixed frames: a 4-byte big-endian length and the bytes.
+A request is a frame with the CPU (seconds) and address space (bytes) limits, 0 for none,
+a frame with the environment ("NAME=value" strings separated by NULs), then stdin frames
+and an empty frame. The reply is the script's stdout and stderr as frames, an empty frame,
+and a 4-byte frame with its wait status.
+"""
+import os
+import resource
+import runpy
+import select
+import signal
+import struct
+import sys
+import threading
+import traceback
+
+try:
+    import ctypes
+    libc = ctypes.CDLL(None)
+except (ImportError, OSError):
+    libc = None
+
+PR_SET_PDEATHSIG = 1
+
+
+def read_exact(n):
+    data = b""
+    while len(data) < n:
+        chunk = os.read(0, n - len(data))
+        if not chunk:
+            os._exit(0)
+        data += chunk
+    return data
+
+
+def read_frame():
+    return read_exact(struct.unpack(">I", read_exact(4))[0])
+
+
+def write_all(fd, data):
+    data = memoryview(data)
+    while data:
+        data = data[os.write(fd, data):]
+
+
+def write_frame(data):
+    write_all(1, struct.pack(">I", len(data)) + bytes(data))
+
+
+def feed(stdin):
+    """Copies the request's stdin frames to the script until the empty one. What the script
+    does not read is still drained, so the next request starts on a frame boundary."""
+    while True:
+        data = read_frame()
+        if not data:
+            break
+        if stdin is None:
+            continue
+        try:
+            write_all(stdin, data)
+        except OSError:
+            os.close(stdin)
+            stdin = None
+    if stdin is not None:
+        os.close(stdin)
+
+
+def run(limits, environ, stdin, output, worker):
+    # A script outliving a killed worker would run on unwatched.
+    if libc is not None:
+        libc.prctl(PR_SET_PDEATHSIG, signal.SIGKILL)
+    if os.getppid() != worker:
+        os._exit(1)
+    try:
+        cpu, memory = limits
+        if cpu > 0:
+            resource.setrlimit(resource.RLIMIT_CPU, (cpu, cpu + 1))
+        if memory > 0:
+            resource.setrlimit(resource.RLIMIT_AS, (memory, memory))
+    except (ValueError, OSError):
+        os._exit(127)
+    os.dup2(stdin, 0)
+    os.dup2(output, 1)
+    os.dup2(output, 2)
+    os.close(stdin)
+    os.close(output)
+
+    os.environ.clear()
+    os.environ.update(environ)
+    script = environ.get("SCRIPT_FILENAME", "")
+    sys.argv = [script]
+    sys.path[0] = os.path.dirname(os.path.abspath(script))
+    code = 0
+    try:
+        runpy.run_path(script, run_name="__main__")
+    except SystemExit as exit:
+        if exit.code is None:
+            code = 0
+        elif isinstance(exit.code, int):
+            code = exit.code
+        else:
+            print(exit.code, file=sys.stderr)
+            code = 1
+    except BaseException:
+        traceback.print_exc()
+        code = 1
+    for stream in (sys.stdout, sys.stderr):
+        try:
+            stream.flush()
+        except BaseException:
+            pass
+    os._exit(code & 0xFF)
+
+
+def serve():
+    while True:
+        limits = tuple(int(value) for value in read_frame().split())
+        block = read_frame().decode("utf-8", "surrogateescape")
+        environ = dict(item.split("=", 1) for item in block.split("\0") if "=" in item)
+
+        stdin, stdin_writer = os.pipe()
+        output_reader, output = os.pipe()
+        worker = os.getpid()
+        pid = os.fork()
+        if pid == 0:
+            os.close(stdin_writer)
+            os.close(output_reader)
+            run(limits, environ, stdin, output, worker)
+        os.close(stdin)
+        os.close(output)
+
+        pump = threading.Thread(target=feed, args=(stdin_writer,), daemon=True)
+        pump.start()
+        # The server going away ends the script too, rather than leaving it to run unwatched.
+        poller = select.poll()
+        poller.register(output_reader, select.POLLIN)
+        poller.register(0, select.POLLRDHUP)
+        while True:
+            if any(fd == 0 for fd, _ in poller.poll()):
+                os.kill(pid, signal.SIGKILL)
+                os._exit(0)
+            data = os.read(output_reader, 65536)
+            if not data:
+                break
+            write_frame(data)
+        os.close(output_reader)
+        _, status = os.waitpid(pid, 0)
+        write_frame(b"")
+        write_frame(struct.pack(">I", status))
+        pump.join()
+
+
+if __name__ == "__main__":
+    serve()
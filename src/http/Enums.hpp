@@ -50,8 +50,12 @@ namespace http {
 			Forbidden = 403,
 			NotFound = 404,
 			MethodNotAllowed = 405,
+			RequestTimeout = 408,
 			RequestEntityTooLarge = 413,
-			InternalServerError = 500
+			RequestHeaderFieldsTooLarge = 431,
+			InternalServerError = 500,
+			BadGateway = 502,
+			GatewayTimeout = 504
 		};
 
 		inline const char* to_string(Value v) {
@@ -72,10 +76,18 @@ namespace http {
 					return "404";
 				case MethodNotAllowed:
 					return "405";
+				case RequestTimeout:
+					return "408";
 				case RequestEntityTooLarge:
 					return "413";
+				case RequestHeaderFieldsTooLarge:
+					return "431";
 				case InternalServerError:
 					return "500";
+				case BadGateway:
+					return "502";
+				case GatewayTimeout:
+					return "504";
 				default:
 					return "0";
 			}
@@ -103,10 +115,18 @@ namespace http {
 					return "Not Found";
 				case MethodNotAllowed:
 					return "Method Not Allowed";
+				case RequestTimeout:
+					return "Request Timeout";
 				case RequestEntityTooLarge:
 					return "Request Entity Too Large";
+				case RequestHeaderFieldsTooLarge:
+					return "Request Header Fields Too Large";
 				case InternalServerError:
 					return "Internal Server Error";
+				case BadGateway:
+					return "Bad Gateway";
+				case GatewayTimeout:
+					return "Gateway Timeout";
 				default:
 					return "Unknown Status";
 			}
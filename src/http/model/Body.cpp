@@ -1,17 +1,27 @@
 #include "Body.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+
 namespace http {
 	Body::Body() : _type(http::ContentType::UNKNOWN_TYPE), _length(0) {}
 
 	Body::~Body() {}
 
-	Body::Body(const Body& copy) : _data(copy._data), _type(copy._type), _length(copy._length) {}
+	Body::Body(const Body& copy) :
+		_data(copy._data), _type(copy._type), _length(copy._length), _file(copy._file) {}
 
 	Body& Body::operator=(const Body& copy) {
 		if (this != &copy) {
 			this->_data = copy._data;
 			this->_type = copy._type;
 			this->_length = copy._length;
+			this->_file = copy._file;
 		}
 		return (*this);
 	}
@@ -28,6 +38,18 @@ namespace http {
 		return _length;
 	}
 
+	const FileRegion& Body::getFile() const {
+		return _file;
+	}
+
+	bool Body::isFileBacked() const {
+		return _file.isOpen();
+	}
+
+	size_t Body::getSize() const {
+		return _file.isOpen() ? _file.getLength() : _data.size();
+	}
+
 	void Body::setType(http::ContentType::Value type) {
 		_type = type;
 	}
@@ -36,8 +58,64 @@ namespace http {
 		_length = length;
 	}
 
-	void Body::append(const char* data, size_t len) {
-		_data.insert(_data.end(), reinterpret_cast<const unsigned char*>(data),
-					 reinterpret_cast<const unsigned char*>(data) + len);
+	// Once spooled, bytes go to the end of the file instead of memory. Returns false when the
+	// file could not take them.
+	bool Body::append(const char* data, size_t len) {
+		if (!_file.isOpen()) {
+			_data.insert(_data.end(), reinterpret_cast<const unsigned char*>(data),
+						 reinterpret_cast<const unsigned char*>(data) + len);
+			return true;
+		}
+		size_t written = 0;
+		while (written < len) {
+			ssize_t n = ::write(_file.getFd(), data + written, len - written);
+			if (n > 0) {
+				written += static_cast<size_t>(n);
+			} else if (n == -1 && errno == EINTR) {
+				continue;
+			} else {
+				_file.extend(written);
+				return false;
+			}
+		}
+		_file.extend(written);
+		return true;
+	}
+
+	// Moves the buffered bytes into an unlinked temporary file under `directory`; the body then
+	// lives only on disk.
+	bool Body::spool(const char* directory) {
+		int fd = open(directory, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+		if (fd == -1) {
+			std::string path = std::string(directory) + "/webserv-body-XXXXXX";
+			fd = mkostemp(&path[0], O_CLOEXEC);
+			if (fd == -1) return false;
+			unlink(path.c_str());
+		}
+		_file = FileRegion(fd, 0, 0);
+		std::vector<unsigned char> buffered;
+		buffered.swap(_data);
+		return buffered.empty() ||
+			   append(reinterpret_cast<const char*>(buffered.data()), buffered.size());
+	}
+
+	void Body::releaseData(std::vector<unsigned char>& out) {
+		out.clear();
+		out.swap(_data);
+	}
+
+	void Body::attachFile(const FileRegion& file) {
+		_data.clear();
+		_file = file;
+		_length = file.getLength();
+	}
+
+	void Body::swap(Body& other) {
+		_data.swap(other._data);
+		std::swap(_type, other._type);
+		std::swap(_length, other._length);
+		FileRegion file = _file;
+		_file = other._file;
+		other._file = file;
 	}
 }  // namespace http
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "../Enums.hpp"
+#include "FileRegion.hpp"
 
 namespace http {
 	class Body {
@@ -12,6 +13,7 @@ namespace http {
 			std::vector<unsigned char> _data;
 			http::ContentType::Value _type;
 			size_t _length;
+			FileRegion _file;
 
 		public:
 			Body();
@@ -22,11 +24,18 @@ namespace http {
 			const std::vector<unsigned char>& getData() const;
 			http::ContentType::Value getType() const;
 			size_t getLength() const;
+			const FileRegion& getFile() const;
+			bool isFileBacked() const;
+			size_t getSize() const;
 
 			void setType(http::ContentType::Value);
 			void setLength(size_t);
 
-			void append(const char*, size_t);
+			bool append(const char*, size_t);
+			bool spool(const char*);
+			void attachFile(const FileRegion&);
+			void releaseData(std::vector<unsigned char>&);
+			void swap(Body&);
 	};
 }  // namespace http
 
@@ -0,0 +1,62 @@
+// FileRegion.cpp
+#include "FileRegion.hpp"
+
+#include <unistd.h>
+
+namespace http {
+	FileRegion::FileRegion() : _fd(-1), _offset(0), _length(0), _refs(NULL) {}
+
+	FileRegion::FileRegion(int fd, off_t offset, size_t length) :
+		_fd(fd), _offset(offset), _length(length), _refs(new int(1)) {}
+
+	FileRegion::~FileRegion() {
+		release();
+	}
+
+	FileRegion::FileRegion(const FileRegion& copy) :
+		_fd(copy._fd), _offset(copy._offset), _length(copy._length), _refs(copy._refs) {
+		if (_refs) ++*_refs;
+	}
+
+	FileRegion& FileRegion::operator=(const FileRegion& copy) {
+		if (this != &copy) {
+			if (copy._refs) ++*copy._refs;
+			release();
+			_fd = copy._fd;
+			_offset = copy._offset;
+			_length = copy._length;
+			_refs = copy._refs;
+		}
+		return (*this);
+	}
+
+	void FileRegion::release() {
+		if (!_refs) return;
+		if (--*_refs == 0) {
+			if (_fd >= 0) close(_fd);
+			delete _refs;
+		}
+		_fd = -1;
+		_refs = NULL;
+	}
+
+	bool FileRegion::isOpen() const {
+		return _fd >= 0;
+	}
+
+	int FileRegion::getFd() const {
+		return _fd;
+	}
+
+	off_t FileRegion::getOffset() const {
+		return _offset;
+	}
+
+	size_t FileRegion::getLength() const {
+		return _length;
+	}
+
+	void FileRegion::extend(size_t bytes) {
+		_length += bytes;
+	}
+}  // namespace http
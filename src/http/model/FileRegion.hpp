@@ -0,0 +1,35 @@
+// FileRegion.hpp
+#ifndef HTTP_MODEL_FILEREGION_HPP
+#define HTTP_MODEL_FILEREGION_HPP
+
+#include <sys/types.h>
+
+#include <cstddef>
+
+namespace http {
+	class FileRegion {
+		private:
+			int _fd;
+			off_t _offset;
+			size_t _length;
+			int* _refs;
+
+			void release();
+
+		public:
+			FileRegion();
+			FileRegion(int, off_t, size_t);
+			~FileRegion();
+			FileRegion(const FileRegion&);
+			FileRegion& operator=(const FileRegion&);
+
+			bool isOpen() const;
+			int getFd() const;
+			off_t getOffset() const;
+			size_t getLength() const;
+
+			void extend(size_t);
+	};
+}  // namespace http
+
+#endif
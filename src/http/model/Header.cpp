@@ -1,35 +1,94 @@
 // Header.cpp
 #include "Header.hpp"
 
+#include <strings.h>
+
+#include <algorithm>
+
 #include "../../utils/str_utils.hpp"
 
 // 빈 문자열을 돌려줄 때 사용할 정적 객체
 static const std::string EMPTY_STRING = "";
 
 namespace http {
-	Header::Header() {}
+	Header::Header() : _materialized(true) {}
 
 	Header::~Header() {}
 
-	Header::Header(const Header& copy) : _headers(copy._headers) {}
+	Header::Header(const Header& copy) :
+		_raw(copy._raw),
+		_fields(copy._fields),
+		_headers(copy._headers),
+		_materialized(copy._materialized) {}
 
 	Header& Header::operator=(const Header& copy) {
 		if (this != &copy) {
+			this->_raw = copy._raw;
+			this->_fields = copy._fields;
 			this->_headers = copy._headers;
+			this->_materialized = copy._materialized;
 		}
 		return (*this);
 	}
 
+	// Later duplicates win, as they did when every field went through set().
+	const Header::Field* Header::findField(const std::string& key) const {
+		for (std::vector<Field>::const_reverse_iterator it = _fields.rbegin(); it != _fields.rend();
+			 ++it) {
+			if (it->name.length == key.size() &&
+				strncasecmp(_raw.data() + it->name.offset, key.data(), key.size()) == 0)
+				return &*it;
+		}
+		return NULL;
+	}
+
+	void Header::materialize() const {
+		if (_materialized) return;
+		for (std::vector<Field>::const_reverse_iterator it = _fields.rbegin(); it != _fields.rend();
+			 ++it)
+			_headers.insert(std::make_pair(to_lower(text(it->name)), text(it->value)));
+		_materialized = true;
+	}
+
 	const std::map<std::string, std::string>& Header::getHeaders() const {
+		materialize();
 		return _headers;
 	}
 
 	const std::string& Header::get(const std::string& key) const {
+		if (!_materialized) {
+			const Field* field = findField(key);
+			if (!field) return EMPTY_STRING;
+			std::string name = to_lower(text(field->name));
+			std::map<std::string, std::string>::iterator cached = _headers.find(name);
+			if (cached == _headers.end())
+				cached = _headers.insert(std::make_pair(name, text(field->value))).first;
+			return cached->second;
+		}
 		std::map<std::string, std::string>::const_iterator it = _headers.find(to_lower(key));
 		return (it != _headers.end()) ? it->second : EMPTY_STRING;
 	}
 
 	void Header::set(const std::string& key, const std::string& value) {
+		materialize();
 		_headers[to_lower(key)] = value;
 	}
+
+	void Header::adopt(std::string& raw, std::vector<Field>& fields) {
+		_raw.swap(raw);
+		_fields.swap(fields);
+		_headers.clear();
+		_materialized = _fields.empty();
+	}
+
+	std::string Header::text(const Slice& slice) const {
+		return _raw.substr(slice.offset, slice.length);
+	}
+
+	void Header::swap(Header& other) {
+		_raw.swap(other._raw);
+		_fields.swap(other._fields);
+		_headers.swap(other._headers);
+		std::swap(_materialized, other._materialized);
+	}
 }  // namespace http
@@ -4,11 +4,28 @@
 
 #include <map>
 #include <string>
+#include <vector>
+
+#include "Slice.hpp"
 
 namespace http {
+	// Parsed requests keep their header block as received and only record where each field
+	// lives; a field becomes an owned, lowercased map entry the first time someone asks for it.
 	class Header {
+		public:
+			struct Field {
+					Slice name;
+					Slice value;
+			};
+
 		private:
-			std::map<std::string, std::string> _headers;
+			std::string _raw;
+			std::vector<Field> _fields;
+			mutable std::map<std::string, std::string> _headers;
+			mutable bool _materialized;
+
+			const Field* findField(const std::string&) const;
+			void materialize() const;
 
 		public:
 			Header();
@@ -20,6 +37,10 @@ namespace http {
 
 			const std::string& get(const std::string&) const;
 			void set(const std::string&, const std::string&);
+
+			void adopt(std::string&, std::vector<Field>&);
+			std::string text(const Slice&) const;
+			void swap(Header&);
 	};
 }  // namespace http
 
@@ -1,14 +1,25 @@
 // Packet.cpp
 #include "Packet.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace http {
 	Packet::Packet(const StartLine& startLine, const Header& header, const Body& body) :
-		_startLine(startLine), _statusLine(), _header(header), _body(body), _isRequest(true) {}
+		_startLine(startLine),
+		_statusLine(),
+		_header(header),
+		_body(body),
+		_isRequest(true),
+		_startLinePending(false) {}
 
 	Packet::Packet(const StatusLine& statusLine, const Header& header, const Body& body) :
-		_startLine(), _statusLine(statusLine), _header(header), _body(body), _isRequest(false) {}
+		_startLine(),
+		_statusLine(statusLine),
+		_header(header),
+		_body(body),
+		_isRequest(false),
+		_startLinePending(false) {}
 
 	const Header& Packet::getHeader() const {
 		return _header;
@@ -20,6 +31,11 @@ namespace http {
 
 	const StartLine& Packet::getStartLine() const {
 		if (!_isRequest) throw std::logic_error("Packet: not a request.");
+		if (_startLinePending) {
+			_startLine.target = _header.text(_target);
+			_startLine.version = _header.text(_version);
+			_startLinePending = false;
+		}
 		return _startLine;
 	}
 
@@ -36,8 +52,20 @@ namespace http {
 		_header.set(key, value);
 	}
 
-	void Packet::appendBody(const char* data, size_t len) {
-		_body.append(data, len);
+	bool Packet::appendBody(const char* data, size_t len) {
+		return _body.append(data, len);
+	}
+
+	bool Packet::spoolBody(const char* directory) {
+		return _body.spool(directory);
+	}
+
+	void Packet::attachBodyFile(const FileRegion& file) {
+		_body.attachFile(file);
+	}
+
+	void Packet::releaseBody(std::vector<unsigned char>& out) {
+		_body.releaseData(out);
 	}
 
 	void Packet::applyBodyLength(size_t len) {
@@ -47,4 +75,28 @@ namespace http {
 	void Packet::applyBodyType(http::ContentType::Value type) {
 		_body.setType(type);
 	}
+
+	// Takes over the raw request head; target and version are sliced out of it on first use.
+	void Packet::adoptHead(std::string& head, const Slice& target, const Slice& version,
+						   std::vector<Header::Field>& fields) {
+		_header.adopt(head, fields);
+		_target = target;
+		_version = version;
+		_startLinePending = _isRequest;
+	}
+
+	void Packet::swap(Packet& other) {
+		std::swap(_startLine.method, other._startLine.method);
+		_startLine.target.swap(other._startLine.target);
+		_startLine.version.swap(other._startLine.version);
+		_statusLine.version.swap(other._statusLine.version);
+		std::swap(_statusLine.statusCode, other._statusLine.statusCode);
+		_statusLine.reasonPhrase.swap(other._statusLine.reasonPhrase);
+		_header.swap(other._header);
+		_body.swap(other._body);
+		std::swap(_isRequest, other._isRequest);
+		std::swap(_target, other._target);
+		std::swap(_version, other._version);
+		std::swap(_startLinePending, other._startLinePending);
+	}
 }  // namespace http
@@ -7,15 +7,19 @@
 #include "Body.hpp"
 #include "Header.hpp"
 #include "PacketLine.hpp"
+#include "Slice.hpp"
 
 namespace http {
 	class Packet {
 		private:
-			StartLine _startLine;
+			mutable StartLine _startLine;
 			StatusLine _statusLine;
 			Header _header;
 			Body _body;
 			bool _isRequest;
+			Slice _target;
+			Slice _version;
+			mutable bool _startLinePending;
 
 		public:
 			Packet(const StartLine&, const Header&, const Body&);
@@ -28,9 +32,14 @@ namespace http {
 			bool isRequest() const;
 
 			void addHeader(const std::string&, const std::string&);
-			void appendBody(const char*, size_t);
+			bool appendBody(const char*, size_t);
+			bool spoolBody(const char*);
+			void attachBodyFile(const FileRegion&);
+			void releaseBody(std::vector<unsigned char>&);
 			void applyBodyLength(size_t);
 			void applyBodyType(http::ContentType::Value);
+			void adoptHead(std::string&, const Slice&, const Slice&, std::vector<Header::Field>&);
+			void swap(Packet&);
 	};
 }  // namespace http
 
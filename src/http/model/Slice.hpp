@@ -0,0 +1,21 @@
+// Slice.hpp
+#ifndef HTTP_MODEL_SLICE_HPP
+#define HTTP_MODEL_SLICE_HPP
+
+#include <cstddef>
+
+namespace http {
+	// A byte range of a buffer owned elsewhere: the parser's receive buffer while a request is
+	// being parsed, the packet's head once it has been handed over.
+	struct Slice {
+			size_t offset;
+			size_t length;
+
+			Slice() : offset(0), length(0) {}
+			Slice(size_t start, size_t size) : offset(start), length(size) {}
+
+			size_t end() const { return offset + length; }
+	};
+}  // namespace http
+
+#endif
@@ -0,0 +1,46 @@
+// BufferPool.cpp
+#include "BufferPool.hpp"
+
+namespace http {
+	BufferPool::BufferPool() {}
+
+	BufferPool::~BufferPool() {
+		for (int i = 0; i < kClasses; ++i) {
+			for (size_t j = 0; j < _free[i].size(); ++j) delete[] _free[i][j];
+		}
+	}
+
+	// Rounds a request up to its size class, or to whole pages past the largest class.
+	size_t BufferPool::blockSize(size_t minimum) {
+		if (minimum > kMaxBlock) return (minimum + kMinBlock - 1) / kMinBlock * kMinBlock;
+		size_t size = kMinBlock;
+		while (size < minimum) size <<= 1;
+		return size;
+	}
+
+	int BufferPool::classOf(size_t size) {
+		int index = 0;
+		for (size_t block = kMinBlock; block <= kMaxBlock; block <<= 1, ++index) {
+			if (block == size) return index;
+		}
+		return -1;
+	}
+
+	char* BufferPool::acquire(size_t size) {
+		int index = classOf(size);
+		if (index < 0 || _free[index].empty()) return new char[size];
+		char* block = _free[index].back();
+		_free[index].pop_back();
+		return block;
+	}
+
+	void BufferPool::release(char* block, size_t size) {
+		if (!block) return;
+		int index = classOf(size);
+		if (index < 0 || _free[index].size() >= kMaxFree) {
+			delete[] block;
+			return;
+		}
+		_free[index].push_back(block);
+	}
+}  // namespace http
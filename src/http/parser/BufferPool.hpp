@@ -0,0 +1,37 @@
+// BufferPool.hpp
+#ifndef HTTP_PARSER_BUFFERPOOL_HPP
+#define HTTP_PARSER_BUFFERPOOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace http {
+	// Receive buffers in power-of-two size classes from 4 KiB to 64 KiB. Connections hand
+	// theirs back as soon as they have nothing buffered, so idle keep-alive clients hold no
+	// receive memory and the next burst of input is served without the allocator. Larger
+	// blocks (a big body went through them) bypass the pool. Not shared between threads.
+	class BufferPool {
+		private:
+			static const size_t kMinBlock = 4 * 1024;
+			static const size_t kMaxBlock = 64 * 1024;
+			static const int kClasses = 5;
+			static const size_t kMaxFree = 256;
+
+			std::vector<char*> _free[kClasses];
+
+			BufferPool(const BufferPool&);
+			BufferPool& operator=(const BufferPool&);
+
+			static int classOf(size_t);
+
+		public:
+			BufferPool();
+			~BufferPool();
+
+			static size_t blockSize(size_t);
+			char* acquire(size_t);
+			void release(char*, size_t);
+	};
+}  // namespace http
+
+#endif
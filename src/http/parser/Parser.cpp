@@ -1,31 +1,73 @@
 // Parser.cpp
 #include "Parser.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <limits>
 #include <sstream>
 
-#include "exception/NeedMoreInput.hpp"
-#include "exception/ParserException.hpp"
+#include "../../utils/str_utils.hpp"
 
 namespace http {
+	static const char* const kBodyTempPath = "/tmp";
+	// The head is held whole until its blank line; like nginx's 4 x 8k header buffers, a
+	// bigger one is refused instead of growing the receive buffer without bound.
+	static const size_t kMaxHeadSize = 32 * 1024;
+
+	static size_t skipSpace(const char* data, size_t cursor, size_t end) {
+		while (cursor < end && isspace(static_cast<unsigned char>(data[cursor]))) cursor++;
+		return cursor;
+	}
+
+	static size_t skipToken(const char* data, size_t cursor, size_t end) {
+		while (cursor < end && !isspace(static_cast<unsigned char>(data[cursor]))) cursor++;
+		return cursor;
+	}
+
 	Parser::Parser() :
-		_currentState(new PacketLineState()),
-		_rawData(),
+		_state(PacketLine),
+		_pool(NULL),
+		_data(NULL),
+		_capacity(0),
+		_size(0),
+		_base(0),
 		_pos(0),
 		_packet(NULL),
-		_complete(false),
 		_inputEnded(false),
-		_maxBodySize(std::numeric_limits<size_t>::max()) {}
+		_maxBodySize(std::numeric_limits<size_t>::max()),
+		_bodyBufferSize(std::numeric_limits<size_t>::max()),
+		_bodyTempPath(kBodyTempPath),
+		_remain(0),
+		_headFirst(false),
+		_headPending(false),
+		_streamBody(false),
+		_streamed(0),
+		_errorCode(http::StatusCode::BadRequest) {}
 
 	Parser::~Parser() {
-		delete _currentState;
 		if (_packet) delete _packet;
+		delete[] _data;
+	}
+
+	bool Parser::hasPendingInput() const {
+		return _pos < _size || _state != PacketLine;
+	}
+
+	bool Parser::inBody() const {
+		return _state >= Body && _state <= ChunkTrailer;
 	}
 
 	void Parser::markEndOfInput() {
 		_inputEnded = true;
 	}
 
+	// A read that brought nothing still took a block through writable(); with no bytes held
+	// it goes back to the pool so an idle connection keeps no receive memory.
+	void Parser::releaseIdleBuffer() {
+		if (_data && _base == _size) releaseBuffer();
+	}
+
 	bool Parser::inputEnded() const {
 		return _inputEnded;
 	}
@@ -34,82 +76,432 @@ namespace http {
 		_maxBodySize = maxSize;
 	}
 
+	void Parser::setBodyBufferSize(size_t size) {
+		_bodyBufferSize = size;
+	}
+
+	void Parser::setBodyTempPath(const std::string& path) {
+		_bodyTempPath = path;
+	}
+
+	void Parser::setBufferPool(BufferPool* pool) {
+		_pool = pool;
+	}
+
+	void Parser::setHeadFirst(bool headFirst) {
+		_headFirst = headFirst;
+	}
+
 	Parser::Result Parser::parse() {
 		Result outcome;
+		Step result = Advanced;
 
-		try {
-			if (!_complete) {
-				while (true) {
-					_currentState->parse(this);
-					_currentState->handleNextState(this);
-					if (dynamic_cast<DoneState*>(_currentState)) {
-						_complete = true;
-						break;
-					}
-				}
+		while (_state != Done && _state != Failed && result == Advanced) {
+			result = step();
+			if (_headPending) {
+				_headPending = false;
+				outcome.status = Result::HeadReady;
+				return outcome;
 			}
-		} catch (const NeedMoreInput&) {
-			if (_inputEnded) {
-				outcome.status = Result::Error;
-				outcome.errorCode = http::StatusCode::BadRequest;
-				outcome.errorMessage = "Malformed request: message incomplete";
-			} else
-				outcome.status = Result::Incomplete;
-			return outcome;
-		} catch (const ParserException& e) {
+		}
+
+		if (_state == Failed) {
 			outcome.status = Result::Error;
-			outcome.errorCode = e.getStatusCode();
-			outcome.errorMessage = e.what();
+			outcome.errorCode = _errorCode;
+			outcome.errorMessage = _errorMessage;
 			return outcome;
 		}
-
-		if (_complete) {
+		if (_state == Done) {
 			outcome.status = Result::Completed;
-			if (_packet) outcome.packet = *_packet;
-			if (_pos < _rawData.size()) outcome.leftover = _rawData.substr(_pos);
+			if (_packet) outcome.packet.swap(*_packet);
 			outcome.endOfInput = _inputEnded;
-			reset();
-			return outcome;
+			restart();
 		}
-		outcome.status = Result::Incomplete;
 		return outcome;
 	}
 
-	void Parser::changeState(ParseState* newState) {
-		if (_currentState) delete _currentState;
-		_currentState = newState;
+	Parser::Step Parser::step() {
+		switch (_state) {
+			case PacketLine:
+				return parsePacketLine();
+			case Headers:
+				return parseHeaders();
+			case Body:
+				return parseBody();
+			case ChunkSize:
+				return parseChunkSize();
+			case ChunkData:
+				return parseChunkData();
+			case ChunkDelimiter:
+				return parseChunkDelimiter();
+			case ChunkTrailer:
+				return parseChunkTrailer();
+			default:
+				return Advanced;
+		}
 	}
 
-	void Parser::append(const std::string& chunk) {
-		_rawData.append(chunk);
-		if (!chunk.empty()) _inputEnded = false;
+	Parser::Step Parser::parsePacketLine() {
+		Slice line;
+		if (!readLine(line)) return needHead("Malformed request: unexpected end of request line");
+
+		const char* data = at(line);
+		size_t end = line.length;
+		size_t cursor = skipSpace(data, 0, end);
+		Slice first(cursor, skipToken(data, cursor, end) - cursor);
+		cursor = skipSpace(data, first.end(), end);
+		Slice second(cursor, skipToken(data, cursor, end) - cursor);
+		cursor = second.end();
+		if (cursor < end && data[cursor] == ' ') cursor++;
+		Slice rest(cursor, end - cursor);
+
+		std::string t1(data + first.offset, first.length);
+		Method::Value method = Method::to_value(t1);
+		if (method == Method::UNKNOWN_METHOD && t1.size() >= 5 && t1.compare(0, 5, "HTTP/") == 0) {
+			StatusLine statusLine = {t1,
+									 StatusCode::to_value(std::string(data + second.offset,
+																	  second.length)),
+									 std::string(data + rest.offset, rest.length)};
+			_packet = new Packet(statusLine, Header(), http::Body());
+		} else {
+			StartLine startLine = {method, std::string(), std::string()};
+			_packet = new Packet(startLine, Header(), http::Body());
+			_target = Slice(line.offset + second.offset, second.length);
+			_version = Slice(line.offset + rest.offset, rest.length);
+		}
+		_state = Headers;
+		return Advanced;
+	}
+
+	Parser::Step Parser::parseHeaders() {
+		Slice line;
+
+		while (readLine(line)) {
+			if (line.length == 0) {
+				if (_pos - _base > kMaxHeadSize)
+					return fail("Request header too large",
+								http::StatusCode::RequestHeaderFieldsTooLarge);
+				adoptHead();
+				return startBody();
+			}
+
+			const char* data = at(line);
+			const char* colon = static_cast<const char*>(memchr(data, ':', line.length));
+			if (!colon || colon == data)
+				return fail("Malformed header line", http::StatusCode::BadRequest);
+
+			size_t sep = colon - data;
+			size_t first = sep + 1;
+			size_t last = line.length;
+			while (first < last && (data[first] == ' ' || data[first] == '\t')) first++;
+			while (last > first && (data[last - 1] == ' ' || data[last - 1] == '\t')) last--;
+
+			Header::Field field;
+			field.name = Slice(line.offset, sep);
+			field.value = Slice(line.offset + first, last - first);
+			_fields.push_back(field);
+		}
+		return needHead("Malformed request: header line truncated");
+	}
+
+	Parser::Step Parser::startBody() {
+		const Header& header = _packet->getHeader();
+		if (_packet->isRequest() && header.get("host").empty())
+			return fail("Host header is missing", http::StatusCode::BadRequest);
+
+		const std::string& transferEncoding = header.get("Transfer-Encoding");
+		bool isChunked = false;
+		if (!transferEncoding.empty()) {
+			if (to_lower(transferEncoding).find("chunked") != std::string::npos)
+				isChunked = true;
+			else
+				return fail("Unsupported Transfer-Encoding", http::StatusCode::BadRequest);
+		}
+
+		const std::string& lengthStr = header.get("Content-Length");
+		if (isChunked && !lengthStr.empty())
+			return fail("Content-Length must not be sent with chunked body",
+						http::StatusCode::BadRequest);
+
+		if (isChunked) {
+			_packet->applyBodyLength(0);
+			_headPending = _headFirst;
+			_state = ChunkSize;
+			return Advanced;
+		}
+
+		size_t contentLength = 0;
+		if (!lengthStr.empty()) {
+			for (size_t i = 0; i < lengthStr.size(); ++i) {
+				if (!isdigit(static_cast<unsigned char>(lengthStr[i])))
+					return fail("Invalid Content-Length value", http::StatusCode::BadRequest);
+			}
+			contentLength = str_toint(lengthStr);
+		}
+		if (contentLength > _maxBodySize)
+			return fail("Payload too large", http::StatusCode::RequestEntityTooLarge);
+
+		_packet->applyBodyLength(contentLength);
+		_packet->applyBodyType(http::ContentType::to_value(header.get("Content-Type")));
+		_remain = contentLength;
+		_headPending = _headFirst && contentLength > 0;
+		_state = contentLength == 0 ? Done : Body;
+		return Advanced;
+	}
+
+	Parser::Step Parser::parseBody() {
+		Slice chunk;
+		if (!_streamBody && readSome(_remain, chunk)) {
+			Step stored = storeBody(chunk);
+			if (stored != Advanced) return stored;
+			_remain -= chunk.length;
+		}
+		if (_remain > 0) return needMore("Malformed request: Body incomplete");
+
+		_packet->applyBodyLength(receivedBody());
+		_state = Done;
+		return Advanced;
+	}
+
+	// Body bytes are handed over as they arrive, to memory up to client_body_buffer_size and to
+	// an unlinked temp file past it, and are never looked at again, so the receive buffer is free
+	// to reuse their space.
+	Parser::Step Parser::storeBody(const Slice& chunk) {
+		const http::Body& body = _packet->getBody();
+		if (body.getSize() + chunk.length > _maxBodySize)
+			return fail("Payload too large", http::StatusCode::RequestEntityTooLarge);
+		if (!body.isFileBacked() && body.getSize() + chunk.length > _bodyBufferSize &&
+			!_packet->spoolBody(_bodyTempPath.c_str()))
+			return fail("Request body could not be buffered",
+						http::StatusCode::InternalServerError);
+		if (!_packet->appendBody(at(chunk), chunk.length))
+			return fail("Request body could not be buffered",
+						http::StatusCode::InternalServerError);
+		_base = _pos;
+		return Advanced;
+	}
+
+	Parser::Step Parser::parseChunkSize() {
+		Slice slice;
+		if (!readLine(slice)) return needMore("Malformed request: chunk size truncated");
+
+		std::string line = text(slice);
+		size_t semicolon = line.find(';');
+		if (semicolon != std::string::npos) line.resize(semicolon);
+
+		line.erase(0, line.find_first_not_of(" \t"));
+		if (!line.empty()) line.erase(line.find_last_not_of(" \t") + 1);
+
+		if (line.empty()) return fail("Malformed chunk size line", http::StatusCode::BadRequest);
+
+		std::istringstream iss(line);
+		size_t chunkSize = 0;
+		iss >> std::hex >> chunkSize;
+		if (!iss || !iss.eof()) return fail("Invalid chunk size", http::StatusCode::BadRequest);
+
+		_remain = chunkSize;
+		_state = _remain == 0 ? ChunkTrailer : ChunkData;
+		return Advanced;
+	}
+
+	Parser::Step Parser::parseChunkData() {
+		size_t currentSize = receivedBody();
+		if (_remain > _maxBodySize || currentSize + _remain > _maxBodySize)
+			return fail("Payload too large", http::StatusCode::RequestEntityTooLarge);
+
+		Slice data;
+		if (!_streamBody && readSome(_remain, data)) {
+			Step stored = storeBody(data);
+			if (stored != Advanced) return stored;
+			_remain -= data.length;
+		}
+		if (_remain > 0) return needMore("Malformed request: Body incomplete");
+
+		_state = ChunkDelimiter;
+		return Advanced;
+	}
+
+	Parser::Step Parser::parseChunkDelimiter() {
+		Slice delim;
+		if (!readBytes(2, delim)) return needMore("Malformed request: chunk delimiter missing");
+		if (memcmp(at(delim), "\r\n", 2) != 0)
+			return fail("Chunk delimiter missing", http::StatusCode::BadRequest);
+
+		_state = ChunkSize;
+		return Advanced;
+	}
+
+	Parser::Step Parser::parseChunkTrailer() {
+		Slice line;
+		if (!readLine(line)) return needMore("Malformed request: chunk trailer truncated");
+		if (line.length == 0) {
+			_packet->applyBodyLength(receivedBody());
+			_state = Done;
+		}
+		return Advanced;
+	}
+
+	size_t Parser::receivedBody() const {
+		return _streamBody ? _streamed : _packet->getBody().getSize();
+	}
+
+	// Running out of bytes is only an error once the peer has stopped sending.
+	Parser::Step Parser::needMore(const char* truncated) {
+		if (!_inputEnded) return NeedMore;
+		return fail(truncated, http::StatusCode::BadRequest);
+	}
+
+	Parser::Step Parser::needHead(const char* truncated) {
+		if (_size - _base > kMaxHeadSize)
+			return fail("Request header too large", http::StatusCode::RequestHeaderFieldsTooLarge);
+		return needMore(truncated);
+	}
+
+	Parser::Step Parser::fail(const std::string& message, http::StatusCode::Value code) {
+		_errorMessage = message;
+		_errorCode = code;
+		_state = Failed;
+		return Invalid;
+	}
+
+	char* Parser::writable(size_t minimum, size_t& available) {
+		if (_capacity - _size < minimum) reserve(minimum);
+		available = _capacity - _size;
+		return _data + _size;
+	}
+
+	void Parser::commit(size_t written) {
+		_size += written;
+		if (written) _inputEnded = false;
+	}
+
+	const Packet& Parser::head() const {
+		return *_packet;
+	}
+
+	void Parser::streamBody() {
+		_streamBody = true;
+	}
+
+	// The body bytes of the current chunk (or of the whole Content-Length body) that are already
+	// buffered, in place; framing between chunks is left to parse().
+	size_t Parser::bodyAvailable(const char*& data) const {
+		if (!_streamBody || (_state != Body && _state != ChunkData) || _pos >= _size) return 0;
+		data = _data + _pos;
+		return std::min(_remain, _size - _pos);
+	}
+
+	void Parser::consumeBody(size_t n) {
+		_pos += n;
+		_remain -= n;
+		_streamed += n;
+		_base = _pos;
+	}
+
+	size_t Parser::buffered() const {
+		return _size - _pos;
 	}
 
 	void Parser::reset() {
-		delete _currentState;
-		_currentState = new PacketLineState();
+		_base = _pos = _size;
+		_inputEnded = false;
+		restart();
+	}
+
+	// Finished requests only move the cursor; pipelined bytes behind them stay where they are
+	// until a read needs the room. Once nothing is buffered the block goes back to the pool.
+	void Parser::restart() {
 		if (_packet) {
 			delete _packet;
 			_packet = NULL;
 		}
-		_rawData.clear();
-		_pos = 0;
-		_complete = false;
-		_inputEnded = false;
+		_base = _pos;
+		_state = PacketLine;
+		_remain = 0;
+		_headPending = false;
+		_streamBody = false;
+		_streamed = 0;
+		_fields.clear();
+		if (_pos == _size) releaseBuffer();
+	}
+
+	// Slices are relative to _base, so sliding the live bytes down invalidates none of them.
+	void Parser::compact() {
+		std::memmove(_data, _data + _base, _size - _base);
+		_size -= _base;
+		_pos -= _base;
+		_base = 0;
+	}
+
+	// Reclaims the consumed prefix when that frees enough room, otherwise moves the live bytes
+	// to a block at least twice as large.
+	void Parser::reserve(size_t minimum) {
+		size_t live = _size - _base;
+		if (_capacity - live >= minimum) {
+			compact();
+			return;
+		}
+		size_t capacity = BufferPool::blockSize(std::max(live + minimum, _capacity * 2));
+		char* block = _pool ? _pool->acquire(capacity) : new char[capacity];
+		if (live) std::memcpy(block, _data + _base, live);
+		size_t pos = _pos - _base;
+		releaseBuffer();
+		_data = block;
+		_capacity = capacity;
+		_size = live;
+		_pos = pos;
+	}
+
+	void Parser::releaseBuffer() {
+		if (_pool)
+			_pool->release(_data, _capacity);
+		else
+			delete[] _data;
+		_data = NULL;
+		_capacity = _size = _base = _pos = 0;
+	}
+
+	// Hands the request line and header block to the packet in a single copy, after which the
+	// buffer no longer needs them.
+	void Parser::adoptHead() {
+		std::string head(_data + _base, _pos - _base);
+		_packet->adoptHead(head, _target, _version, _fields);
+		_base = _pos;
+	}
+
+	bool Parser::readLine(Slice& line) {
+		if (_pos >= _size) return false;
+		const char* start = _data + _pos;
+		const char* end = _data + _size;
+		const char* next = start;
+		while ((next = static_cast<const char*>(std::memchr(next, '\r', end - next))) &&
+			   next + 1 < end && next[1] != '\n')
+			next++;
+		if (!next || next + 1 >= end) return false;
+		line = Slice(_pos - _base, next - start);
+		_pos += line.length + 2;
+		return true;
 	}
 
-	std::string Parser::readLine() {
-		size_t next = _rawData.find("\r\n", _pos);
-		if (next == std::string::npos) throw NeedMoreInput();
-		std::string line = _rawData.substr(_pos, next - _pos);
-		_pos = next + 2;
-		return line;
+	bool Parser::readSome(size_t n, Slice& chunk) {
+		if (_pos >= _size) return false;
+		chunk = Slice(_pos - _base, std::min(n, _size - _pos));
+		_pos += chunk.length;
+		return true;
 	}
 
-	std::string Parser::readBytes(size_t n) {
-		if (_pos + n > _rawData.size()) throw NeedMoreInput();
-		std::string chunk = _rawData.substr(_pos, n);
+	bool Parser::readBytes(size_t n, Slice& chunk) {
+		if (_pos + n > _size) return false;
+		chunk = Slice(_pos - _base, n);
 		_pos += n;
-		return chunk;
+		return true;
+	}
+
+	const char* Parser::at(const Slice& slice) const {
+		return _data + _base + slice.offset;
+	}
+
+	std::string Parser::text(const Slice& slice) const {
+		return std::string(_data + _base + slice.offset, slice.length);
 	}
 }  // namespace http
@@ -4,44 +4,99 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 
 #include "../model/Packet.hpp"
-#include "./state/BodyState.hpp"
-#include "./state/ChunkedBodyState.hpp"
-#include "./state/DoneState.hpp"
-#include "./state/HeaderState.hpp"
-#include "./state/PacketLineState.hpp"
-#include "./state/ParseState.hpp"
+#include "../model/Slice.hpp"
+#include "BufferPool.hpp"
 
 namespace http {
+	// Incremental request parser. The state lives inline and every step reports whether it
+	// advanced, needs more bytes or failed, so a fragmented request costs no allocation and no
+	// unwinding per read.
 	class Parser {
 		private:
-			ParseState* _currentState;
-			std::string _rawData;
+			enum State {
+				PacketLine,
+				Headers,
+				Body,
+				ChunkSize,
+				ChunkData,
+				ChunkDelimiter,
+				ChunkTrailer,
+				Done,
+				Failed
+			};
+
+			enum Step {
+				Advanced,
+				NeedMore,
+				Invalid
+			};
+
+			State _state;
+			BufferPool* _pool;
+			char* _data;
+			size_t _capacity;
+			size_t _size;
+			size_t _base;
 			size_t _pos;
 			Packet* _packet;
-			bool _complete;
 			bool _inputEnded;
 			size_t _maxBodySize;
+			size_t _bodyBufferSize;
+			std::string _bodyTempPath;
+			size_t _remain;
+			bool _headFirst;
+			bool _headPending;
+			bool _streamBody;
+			size_t _streamed;
+			Slice _target;
+			Slice _version;
+			std::vector<Header::Field> _fields;
+			http::StatusCode::Value _errorCode;
+			std::string _errorMessage;
 
 			Parser(const Parser&);
 			Parser& operator=(const Parser&);
 
-			friend class PacketLineState;
-			friend class HeaderState;
-			friend class BodyState;
-			friend class ChunkedBodyState;
-			friend class DoneState;
+			Step step();
+			Step parsePacketLine();
+			Step parseHeaders();
+			Step startBody();
+			Step parseBody();
+			Step storeBody(const Slice&);
+			Step parseChunkSize();
+			Step parseChunkData();
+			Step parseChunkDelimiter();
+			Step parseChunkTrailer();
+
+			size_t receivedBody() const;
+			Step needMore(const char*);
+			Step needHead(const char*);
+			Step fail(const std::string&, http::StatusCode::Value);
+			void adoptHead();
+			void restart();
+			void compact();
+			void reserve(size_t);
+			void releaseBuffer();
+
+			// These return ranges relative to _base, the first byte still needed by the request.
+			bool readLine(Slice&);
+			bool readBytes(size_t, Slice&);
+			bool readSome(size_t, Slice&);
+			const char* at(const Slice&) const;
+			std::string text(const Slice&) const;
 
 		public:
 			struct Result {
 					enum Status {
 						Incomplete,
+						HeadReady,
 						Completed,
 						Error
 					} status;
 					http::Packet packet;
-					std::string leftover;
 					http::StatusCode::Value errorCode;
 					std::string errorMessage;
 					bool endOfInput;
@@ -59,16 +114,33 @@ namespace http {
 			~Parser();
 
 			bool inputEnded() const;
+			bool hasPendingInput() const;
+			bool inBody() const;
 			void markEndOfInput();
+			void releaseIdleBuffer();
 			void setMaxBodySize(size_t);
+			void setBodyBufferSize(size_t);
+			void setBodyTempPath(const std::string&);
+			void setBufferPool(BufferPool*);
+			void setHeadFirst(bool);
 
 			Result parse();
-			void append(const std::string&);
-			void changeState(ParseState*);
 			void reset();
 
-			std::string readLine();
-			std::string readBytes(size_t);
+			// In head-first mode parse() stops with HeadReady once the head of a request with a
+			// body is in, and head() can be routed on. Calling streamBody() then leaves the body
+			// in the receive buffer for the caller to drain with bodyAvailable()/consumeBody();
+			// parse() still walks the chunk framing and reports Completed at the end.
+			const Packet& head() const;
+			void streamBody();
+			size_t bodyAvailable(const char*&) const;
+			void consumeBody(size_t);
+			size_t buffered() const;
+
+			// Reads land directly in the buffer: writable() guarantees at least the given number
+			// of free bytes and reports how many there are, commit() accepts what was written.
+			char* writable(size_t, size_t&);
+			void commit(size_t);
 	};
 }  // namespace http
 
@@ -1,8 +0,0 @@
-// DoneState.cpp
-#include "DoneState.hpp"
-
-namespace http {
-	void DoneState::parse(Parser*) {}
-
-	void DoneState::handleNextState(Parser*) {}
-}  // namespace http
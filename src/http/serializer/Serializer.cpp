@@ -7,35 +7,43 @@
 #include "../../utils/str_utils.hpp"
 
 namespace http {
-	std::string Serializer::serialize(const Packet& packet) {
+	std::string Serializer::serializeHead(const Packet& packet) {
 		if (packet.isRequest()) throw std::logic_error("Serializer: request packet unsupported");
 
 		std::stringstream ss;
 		const std::map<std::string, std::string>& headers = packet.getHeader().getHeaders();
-		const std::vector<unsigned char>& bodyData = packet.getBody().getData();
-		const size_t bodyLen = bodyData.size();
+		const Body& body = packet.getBody();
+		const size_t bodyLen = body.isFileBacked() ? body.getFile().getLength()
+												   : body.getData().size();
 		const StatusLine statusLine = packet.getStatusLine();
 		bool hasServer = false;
-		bool hasContentLength = false;
 
 		ss << statusLine.version << " " << StatusCode::to_string(statusLine.statusCode) << " "
 		   << statusLine.reasonPhrase << "\r\n";
 		for (std::map<std::string, std::string>::const_iterator it = headers.begin();
 			 it != headers.end(); ++it) {
 			std::string keyLower = to_lower(it->first);
-			if (keyLower == "content-length") {
-				hasContentLength = true;
-				continue;
-			}
+			if (keyLower == "content-length") continue;
 			if (keyLower == "server") hasServer = true;
 			ss << it->first << ": " << it->second << "\r\n";
 		}
 		if (!hasServer) ss << "Server: webserv" << "\r\n";
-		if (bodyLen > 0 || hasContentLength) ss << "Content-Length: " << bodyLen << "\r\n";
+		// Every other response is framed by its length, so an empty body on a kept-alive
+		// connection still ends where the client expects it to.
+		const int code = statusLine.statusCode;
+		if (code >= 200 && code != 204 && code != 304)
+			ss << "Content-Length: " << bodyLen << "\r\n";
 		ss << "\r\n";
-		if (!bodyData.empty())
-			ss.write(reinterpret_cast<const char*>(&bodyData[0]), bodyData.size());
 
 		return ss.str();
 	}
+
+	std::string Serializer::serialize(const Packet& packet) {
+		std::string raw = serializeHead(packet);
+		const std::vector<unsigned char>& bodyData = packet.getBody().getData();
+
+		if (!bodyData.empty())
+			raw.append(reinterpret_cast<const char*>(&bodyData[0]), bodyData.size());
+		return raw;
+	}
 }  // namespace http
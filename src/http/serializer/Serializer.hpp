@@ -9,6 +9,7 @@
 namespace http {
 	class Serializer {
 		public:
+			static std::string serializeHead(const Packet&);
 			static std::string serialize(const Packet&);
 	};
 }  // namespace http
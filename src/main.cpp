@@ -2,16 +2,16 @@
 
 #include "config/model/Config.hpp"
 #include "config/parser/Parser.hpp"
-#include "server/Server.hpp"
+#include "server/master/Master.hpp"
 
 int main(int argc, char* argv[]) {
 	try {
 		config::Parser parser;
 		if (parser.validateArgument(argc)) parser.loadFromFile(argv[1]);
 		std::map<int, config::Config> configs = parser.getConfigs();
-		server::Server server(configs);
+		server::Master master(configs, parser.getHttpConfig());
 
-		server.run();
+		master.run();
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << '\n';
 	}
@@ -22,16 +22,6 @@ std::string Router::parseQueryString(const std::string& uri) const {
 	return "";
 }
 
-bool Router::isCgiRequest(const std::string& locationPath, const std::string& fsPath) const {
-	if (locationPath != "/cgi-bin" && locationPath != "/cgi-bin/") return false;
-
-	unsigned long dot = fsPath.rfind('.');
-	if (dot == std::string::npos) return false;
-
-	std::string ext = fsPath.substr(dot);
-	return ext == ".py";
-}
-
 bool Router::ensureRequestIsValid(const http::Packet& request, RouteDecision& decision) const {
 	if (!request.isRequest()) {
 		decision.action = RouteDecision::Error;
@@ -125,7 +115,18 @@ bool Router::decideResource(const Config& config, const std::string& normPath,
 		return false;
 	}
 
-	if (isCgiRequest(locPrefix, fsPath)) {
+	// A location served by a FastCGI backend hands it every file under it, as nginx does.
+	if (hasLocation) {
+		decision.fastcgiPass = config.getLocationFastcgiPass(locPrefix);
+		decision.cgiPool = config.getLocationCgiPool(locPrefix);
+		decision.cgiTimeout = config.getLocationCgiTimeout(locPrefix);
+		decision.cgiKillTimeout = config.getLocationCgiKillTimeout(locPrefix);
+		decision.cgiCpuLimit = config.getLocationCgiCpuLimit(locPrefix);
+		decision.cgiMemoryLimit = config.getLocationCgiMemoryLimit(locPrefix);
+		const std::string* interpreter = config.getLocationCgiExt(locPrefix).find(fsPath);
+		if (interpreter) decision.cgiInterpreter = *interpreter;
+	}
+	if (!decision.fastcgiPass.empty() || !decision.cgiInterpreter.empty()) {
 		decision.action = RouteDecision::Cgi;
 		return true;
 	}
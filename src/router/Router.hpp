@@ -22,7 +22,6 @@ namespace router {
 			bool decideResource(const config::Config&, const std::string&, const std::string&,
 								RouteDecision&) const;
 			std::string parseQueryString(const std::string&) const;
-			bool isCgiRequest(const std::string&, const std::string&) const;
 
 		public:
 			Router() {}
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#include "../../config/Defaults.hpp"
 #include "../../config/model/Config.hpp"
 #include "../../http/Enums.hpp"
 
@@ -27,12 +28,26 @@ namespace router {
 			std::string fsPath;
 			std::string indexUsed;
 			std::string contentTypeHint;
+			std::string fastcgiPass;
+			std::string cgiInterpreter;
+			int cgiPool;
+			long cgiTimeout;
+			long cgiKillTimeout;
+			long cgiCpuLimit;
+			long long cgiMemoryLimit;
 
 			std::vector<std::string> allowMethods;
 			std::string redirectLocation;
 
 			RouteDecision() :
-				action(Error), status(http::StatusCode::InternalServerError), server(NULL) {}
+				action(Error),
+				status(http::StatusCode::InternalServerError),
+				server(NULL),
+				cgiPool(0),
+				cgiTimeout(config::defaults::CGI_TIMEOUT),
+				cgiKillTimeout(config::defaults::CGI_KILL_TIMEOUT),
+				cgiCpuLimit(0),
+				cgiMemoryLimit(0) {}
 	};
 
 }  // namespace router
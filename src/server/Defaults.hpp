@@ -2,10 +2,23 @@
 #ifndef SERVER_DEFAULTS_HPP
 #define SERVER_DEFAULTS_HPP
 
+#include <cstddef>
+
 namespace server {
 	namespace defaults {
 		static const int EPOLL_SIZE = 128;
-		static const int BUFFER_SIZE = 30000;
+		static const size_t READ_CHUNK_SIZE = 4 * 1024;
+		static const size_t OUTPUT_HIGH_WATER_MARK = 1024 * 1024;
+		static const size_t OUTPUT_LOW_WATER_MARK = 256 * 1024;
+		static const size_t SENDFILE_CHUNK_SIZE = 1024 * 1024;
+		static const int WRITEV_MAX_IOVEC = 64;
+		static const unsigned long TIMER_TICK_MS = 100;
+		static const int ACCEPT_BATCH = 64;
+		static const unsigned URING_QUEUE_SIZE = 256;
+		static const unsigned URING_COMPLETION_SIZE = 4096;
+		static const unsigned URING_BUFFER_COUNT = 128;
+		static const size_t URING_BUFFER_SIZE = 16 * 1024;
+		static const size_t PIPE_CHUNK_SIZE = 64 * 1024;
 	}
 }  // namespace server
 
@@ -2,90 +2,424 @@
 #include "Server.hpp"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <sys/epoll.h>
 
 #include <algorithm>
+#include <cerrno>
 #include <iostream>
 
-#include "../http/serializer/Serializer.hpp"
+#include "../config/Defaults.hpp"
+#include "Defaults.hpp"
 #include "epoll/exception/EpollException.hpp"
 #include "exception/Exception.hpp"
+#include "uring/exception/UringException.hpp"
 #include "wrapper/SocketWrapper.hpp"
 
 using namespace server;
 using namespace handler;
 
-Server::Server(const std::map<int, config::Config>& configs) :
-	_configs(configs), _clientSocket(-1), _socketOption(1), _addressSize(sizeof(_serverAddress)) {}
+Server::Server(const std::map<int, config::Config>& configs, const config::HttpConfig& httpConfig) :
+	_configs(configs),
+	_httpConfig(httpConfig),
+	_sharedListeners(false),
+	_clientSocket(-1),
+	_addressSize(sizeof(_clientAddress)),
+	_spareFd(-1),
+	_uring(NULL),
+	_epollReady(false),
+	_connections(httpConfig.getWorkerConnections()),
+	_timers(defaults::TIMER_TICK_MS) {}
+
+Server::Server(const std::map<int, config::Config>& configs, const config::HttpConfig& httpConfig,
+			   const std::set<int>& listeners) :
+	_configs(configs),
+	_httpConfig(httpConfig),
+	_sharedListeners(true),
+	_clientSocket(-1),
+	_addressSize(sizeof(_clientAddress)),
+	_spareFd(-1),
+	_uring(NULL),
+	_epollReady(false),
+	_connections(httpConfig.getWorkerConnections()),
+	_timers(defaults::TIMER_TICK_MS) {
+	for (std::set<int>::const_iterator it = listeners.begin(); it != listeners.end(); ++it)
+		_serverSockets[*it] = NULL;
+}
+
+Server::~Server() {
+	delete _uring;
+	if (_spareFd != -1) close(_spareFd);
+}
+
+int Server::listenOn(int port, bool reusePort, int backlog) {
+	sockaddr_in serverAddress;
+	int socketOption = 1;
+
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_port = htons(port);
+	serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+	std::fill(serverAddress.sin_zero, serverAddress.sin_zero + 8, 0);
+
+	int serverSocket = socket::create(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	socket::setOption(serverSocket, SOL_SOCKET, SO_REUSEADDR, &socketOption,
+					  sizeof(socketOption));
+	if (reusePort)
+		socket::setOption(serverSocket, SOL_SOCKET, SO_REUSEPORT, &socketOption,
+						  sizeof(socketOption));
+	socket::bind(serverSocket, reinterpret_cast<sockaddr*>(&serverAddress),
+				 sizeof(serverAddress));
+	socket::listen(serverSocket, backlog);
+	return serverSocket;
+}
 
 void Server::initServer(int port) {
-	_serverAddress.sin_family = AF_INET;
-	_serverAddress.sin_port = htons(port);
-	_serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
-	std::fill(_serverAddress.sin_zero, _serverAddress.sin_zero + 8, 0);
+	std::map<int, config::Config>::const_iterator it = _configs.find(port);
+	int serverSocket = listenOn(port, _httpConfig.getWorkerProcesses() > 1,
+								it->second.getListenBacklog());
+	_serverSockets[serverSocket] = &it->second;
+	if (_uring)
+		_uring->accept(serverSocket);
+	else
+		_epollManager.add(serverSocket);
+}
 
-	int serverSocket = socket::create(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
-	socket::setOption(serverSocket, SOL_SOCKET, SO_REUSEADDR, &_socketOption,
-					  sizeof(_socketOption));
-	socket::bind(serverSocket, reinterpret_cast<sockaddr*>(&_serverAddress),
-				 sizeof(_serverAddress));
-	socket::listen(serverSocket, 10);
-	_serverSockets.insert(serverSocket);
-	_epollManager.add(serverSocket);
+void Server::registerListener(int serverSocket) {
+	sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	if (getsockname(serverSocket, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
+		_serverSockets[serverSocket] = findConfig(ntohs(addr.sin_port));
+	if (_uring)
+		_uring->accept(serverSocket);
+	else
+		_epollManager.add(serverSocket, EPOLLIN | EPOLLEXCLUSIVE);
 }
 
+// Only an error ends the loop. It is reported here; the master replaces the worker process
+// or thread that ran it.
 void Server::loop() {
 	try {
 		while (true) {
-			_epollManager.wait();
-			handleEvents();
+			if (_uring) {
+				waitCompletions();
+			} else {
+				_epollManager.wait(nextTimeout());
+				handleEvents();
+			}
+			expireTimers();
+			releaseClosed();
 		}
 	} catch (const server::Exception& e) {
 		std::cerr << e.what() << std::endl;
 	} catch (const server::EpollException& e) {
 		std::cerr << e.what() << std::endl;
+	} catch (const server::UringException& e) {
+		std::cerr << e.what() << std::endl;
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
 	} catch (...) {
 		std::cerr << "[Error] Unknown Error" << std::endl;
 	}
+	std::cerr << "[Error] event loop stopped" << std::endl;
 }
 
 void Server::handleEvents() {
 	for (int i = 0; i < _epollManager.eventCount(); i++) {
 		const epoll_event& event = _epollManager.eventAt(i);
-		int eventFd = event.data.fd;
-
-		if (_serverSockets.find(eventFd) != _serverSockets.end()) {
-			_clientSocket = socket::accept(eventFd, reinterpret_cast<sockaddr*>(&_clientAddress),
-										   reinterpret_cast<socklen_t*>(&_addressSize));
-			_epollManager.add(_clientSocket);
+		Connection* conn = static_cast<Connection*>(EpollManager::contextOf(event));
+		if (conn) {
+			handleClientEvent(*conn, event.events);
 			continue;
 		}
 
-		int localPort = 0;
-		sockaddr_in addr;
-		socklen_t len = sizeof(addr);
-		if (getsockname(eventFd, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
-			localPort = ntohs(addr.sin_port);
+		int eventFd = EpollManager::fdOf(event);
+		std::map<int, const config::Config*>::const_iterator listener =
+			_serverSockets.find(eventFd);
+		if (listener != _serverSockets.end())
+			acceptClients(eventFd, listener->second);
+		else
+			handleCgiEvent(eventFd, event.events);
+	}
+}
+
+void Server::handleClientEvent(Connection& conn, uint32_t events) {
+	// Closed earlier in this batch; the fd stays open until releaseClosed(), so the slot
+	// cannot have been handed to a new client yet.
+	if (!_connections.contains(conn.fd)) return;
+	if (events & (EPOLLIN | EPOLLRDHUP)) _connections.markActive(conn.fd);
+
+	if (conn.sending()) {
+		if (events & (EPOLLERR | EPOLLHUP)) {
+			closeClient(conn);
+			return;
+		}
+		if ((events & EPOLLOUT) && !flushOutput(conn)) return;
+		if (!(events & (EPOLLIN | EPOLLRDHUP))) {
+			refreshTimer(conn);
+			return;
+		}
+	}
+
+	EventHandler::Result result = _eventHandler.handleEvent(conn, events, _epollManager);
+	dispatchResult(result);
+	if (_connections.contains(conn.fd)) updateInterest(conn);
+	refreshTimer(conn);
+}
+
+// One io_uring_enter submits what the last iteration queued and waits. CGI descriptors stay on
+// epoll, whose fd the ring watches; once it fires, epoll is drained without blocking until it
+// comes back empty, since a level-triggered fd that is still ready does not wake the ring again.
+void Server::waitCompletions() {
+	_uring->wait(_epollReady ? 0 : nextTimeout());
+	handleCompletions();
+	if (!_epollReady) return;
+	_epollManager.wait(0);
+	_epollReady = _epollManager.eventCount() > 0;
+	handleEvents();
+}
 
-		EventHandler::Result result =
-			_eventHandler.handleEvent(eventFd, event.events, findConfig(localPort), _epollManager);
+void Server::handleCompletions() {
+	for (int i = 0; i < _uring->completionCount(); ++i) {
+		const UringManager::Completion& completion = _uring->completionAt(i);
+		switch (completion.operation()) {
+			case UringManager::AcceptOp:
+				acceptCompleted(completion);
+				break;
+			case UringManager::ReceiveOp:
+				receiveCompleted(completion);
+				break;
+			case UringManager::SendOp:
+				sendCompleted(completion);
+				break;
+			case UringManager::WatchOp:
+				_epollReady = true;
+				if (!completion.more()) _uring->watch(completion.fd());
+				break;
+			default:
+				break;
+		}
+	}
+}
 
-		if (result.response.fd != -1) {
-			sendResponse(result.response.fd, result.response.data);
-			if (result.response.closeAfterSend) {
-				_eventHandler.cleanup(result.response.fd, _epollManager);
-				_epollManager.remove(result.response.fd);
-			}
+void Server::acceptCompleted(const UringManager::Completion& completion) {
+	int serverSocket = completion.fd();
+	std::map<int, const config::Config*>::const_iterator listener =
+		_serverSockets.find(serverSocket);
+	if (listener == _serverSockets.end()) return;
+	if (completion.step() == 1) {
+		_uring->accept(serverSocket);
+		return;
+	}
+	if (_spareFd == -1) _spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+	bool exhausted = completion.result == -EMFILE || completion.result == -ENFILE;
+	if (completion.result >= 0) {
+		sockaddr_in peer;
+		socklen_t length = sizeof(peer);
+		std::fill(reinterpret_cast<char*>(&peer), reinterpret_cast<char*>(&peer + 1), 0);
+		getpeername(completion.result, reinterpret_cast<sockaddr*>(&peer), &length);
+		openClient(completion.result, listener->second, peer);
+	} else if (exhausted) {
+		shedClient(serverSocket);
+	}
+	// An error ends a multishot accept.
+	if (completion.more()) return;
+	if (exhausted)
+		_uring->awaitClient(serverSocket);
+	else
+		_uring->accept(serverSocket);
+}
+
+void Server::receiveCompleted(const UringManager::Completion& completion) {
+	Connection* conn = _connections.pooled(completion.fd());
+	if (!conn) {
+		_uring->recycle(completion);
+		return;
+	}
+	if (!completion.more()) {
+		conn->receiving = false;
+		conn->receiveCancelled = false;
+	}
+	if (!_connections.contains(conn->fd)) {
+		_uring->recycle(completion);
+		settleDrained(*conn);
+		return;
+	}
+
+	// A cancel asked for by a pause, or a buffer ring that ran dry, only stops the recv; it is
+	// armed again below if input is still wanted.
+	int received = completion.result;
+	bool stopped = received == -ECANCELED || received == -ENOBUFS;
+	if (received > 0 || !stopped) {
+		_connections.markActive(conn->fd);
+		const char* data = received > 0 ? _uring->buffer(completion) : NULL;
+		EventHandler::Result result = _eventHandler.handleReceived(
+			*conn, data, received > 0 ? static_cast<size_t>(received) : 0, _epollManager);
+		_uring->recycle(completion);
+		dispatchResult(result);
+	} else {
+		_uring->recycle(completion);
+	}
+	if (!_connections.contains(conn->fd)) return;
+	updateInterest(*conn);
+	refreshTimer(*conn);
+}
+
+void Server::sendCompleted(const UringManager::Completion& completion) {
+	Connection* conn = _connections.pooled(completion.fd());
+	if (!conn || !conn->output.complete(completion.step(), completion.result)) return;
+	if (!_connections.contains(conn->fd)) {
+		settleDrained(*conn);
+		return;
+	}
+	if (flushOutput(*conn)) refreshTimer(*conn);
+}
+
+// A multishot recv runs while input is wanted; pausing cancels it, and a new one is armed only
+// after the old one has ended, so a connection never has two.
+void Server::armReceive(Connection& conn) {
+	bool wanted = (conn.events & EPOLLIN) != 0;
+	if (wanted && !conn.receiving) {
+		_uring->receive(conn.fd);
+		conn.receiving = true;
+	} else if (!wanted && conn.receiving && !conn.receiveCancelled) {
+		_uring->cancel(conn.fd, UringManager::ReceiveOp);
+		conn.receiveCancelled = true;
+	}
+}
+
+// A closed connection's fd stays open until its last io_uring request is back, so the number
+// cannot be reused while the kernel still acts on it.
+void Server::settleDrained(Connection& conn) {
+	if (!conn.draining || conn.receiving || conn.output.inFlight()) return;
+	releaseConnection(conn);
+}
+
+void Server::releaseConnection(Connection& conn) {
+	conn.draining = false;
+	conn.output.clear();
+	close(conn.fd);
+}
+
+void Server::handleCgiEvent(int cgiFd, uint32_t events) {
+	if (_eventHandler.isCgiConnection(cgiFd)) {
+		handleCgiConnectionEvent(cgiFd, events);
+		return;
+	}
+	Connection* client = _connections.get(_eventHandler.cgiClientOf(cgiFd));
+	if (!client) return;
+
+	EventHandler::Result result =
+		_eventHandler.handleCgiEvent(cgiFd, events, *client, _epollManager);
+	settleCgi(*client, result);
+}
+
+void Server::handleCgiConnectionEvent(int fd, uint32_t events) {
+	_resumed.clear();
+	_eventHandler.handleCgiConnectionEvent(fd, events, _epollManager, _resumed);
+	for (size_t i = 0; i < _resumed.size(); ++i) {
+		Connection* client = _connections.get(_resumed[i]);
+		if (!client) continue;
+		EventHandler::Result result = _eventHandler.resumeCgi(*client, _epollManager);
+		settleCgi(*client, result);
+	}
+}
+
+void Server::settleCgi(Connection& client, EventHandler::Result& result) {
+	dispatchResult(result);
+	if (!_connections.contains(client.fd)) return;
+	if (client.output.waiting() && !flushOutput(client)) return;
+	updateInterest(client);
+	refreshTimer(client);
+}
+
+void Server::dispatchResult(EventHandler::Result& result) {
+	int responseFd = -1;
+	bool closeAfterSend = false;
+	for (std::deque<EventHandler::Response>::iterator it = result.responses.begin();
+		 it != result.responses.end(); ++it) {
+		Connection* conn = _connections.get(it->fd);
+		if (!conn) continue;
+		queueResponse(*conn, *it);
+		responseFd = it->fd;
+		closeAfterSend = closeAfterSend || it->closeAfterSend;
+	}
+	Connection* responder = _connections.get(responseFd);
+	if (responder && flushOutput(*responder)) refreshTimer(*responder);
+
+	Connection* closing = _connections.get(result.closeFd);
+	if (closing && (result.closeFd != responseFd || !closeAfterSend)) closeAfterDrain(*closing);
+}
+
+void Server::refreshTimer(Connection& conn) {
+	if (!_connections.contains(conn.fd)) return;
+	unsigned long long now = TimerWheel::now();
+
+	if (!conn.output.empty() && !conn.output.waiting()) {
+		_timers.schedule(conn.fd, SendTimer, timeoutFor(conn.config, SendTimer), now);
+	} else if (_eventHandler.isReadingBody(conn) && !conn.inputPaused) {
+		_timers.schedule(conn.fd, BodyTimer, timeoutFor(conn.config, BodyTimer), now);
+	} else if (_eventHandler.isWaitingCgi(conn)) {
+		if (conn.cgiDeadline == 0)
+			_timers.cancel(conn.fd);
+		else
+			_timers.schedule(conn.fd, CgiTimer,
+							 conn.cgiDeadline > now ? conn.cgiDeadline - now : 0, now);
+	} else {
+		TimerKind kind = _connections.isIdle(conn.fd) ? KeepaliveTimer : HeaderTimer;
+		if (_timers.kindOf(conn.fd) != kind)
+			_timers.schedule(conn.fd, kind, timeoutFor(conn.config, kind), now);
+	}
+}
+
+// The wheel's next expiry, or a CGI script's SIGKILL if that comes first.
+int Server::nextTimeout() const {
+	unsigned long long now = TimerWheel::now();
+	int timeout = _timers.nextTimeout(now);
+	int cgiTimeout = _eventHandler.nextCgiTimeout(now);
+	if (timeout == -1 || (cgiTimeout != -1 && cgiTimeout < timeout)) return cgiTimeout;
+	return timeout;
+}
+
+void Server::expireTimers() {
+	unsigned long long now = TimerWheel::now();
+	_expired.clear();
+	_timers.expire(now, _expired);
+	_eventHandler.expireCgi(now);
+	for (size_t i = 0; i < _expired.size(); ++i) {
+		Connection* conn = _connections.get(_expired[i].fd);
+		if (!conn) continue;
+
+		if (_expired[i].kind == CgiTimer) {
+			EventHandler::Result result = _eventHandler.handleCgiTimeout(*conn, _epollManager);
+			dispatchResult(result);
+			if (_connections.contains(conn->fd)) refreshTimer(*conn);
+			continue;
 		}
 
-		if (result.closeFd != -1 &&
-			(result.closeFd != result.response.fd || !result.response.closeAfterSend)) {
-			_eventHandler.cleanup(result.closeFd, _epollManager);
-			_epollManager.remove(result.closeFd);
+		bool partialRequest = _expired[i].kind == BodyTimer ||
+							  (_expired[i].kind == HeaderTimer && !_eventHandler.isIdle(*conn));
+		if (!partialRequest) {
+			closeClient(*conn);
+			continue;
 		}
+		EventHandler::Result result = _eventHandler.handleTimeout(*conn);
+		dispatchResult(result);
+	}
+}
+
+unsigned long Server::timeoutFor(const config::Config* config, TimerKind kind) {
+	switch (kind) {
+		case HeaderTimer:
+			return config ? config->getClientHeaderTimeout()
+						  : config::defaults::CLIENT_HEADER_TIMEOUT;
+		case BodyTimer:
+			return config ? config->getClientBodyTimeout() : config::defaults::CLIENT_BODY_TIMEOUT;
+		case KeepaliveTimer:
+			return config ? config->getKeepaliveTimeout() : config::defaults::KEEPALIVE_TIMEOUT;
+		default:
+			return config ? config->getSendTimeout() : config::defaults::SEND_TIMEOUT;
 	}
 }
 
@@ -95,27 +429,184 @@ const config::Config* Server::findConfig(int localPort) const {
 	return NULL;
 }
 
-void Server::sendResponse(int socketFd, const http::Packet& httpResponse) {
-	std::string rawResponse = http::Serializer::serialize(httpResponse);
-	::write(socketFd, rawResponse.c_str(), rawResponse.size());
+void Server::queueResponse(Connection& conn, EventHandler::Response& response) {
+	conn.output.push(response.data);
+	conn.output.push(response.body);
+	conn.output.push(response.file);
+	conn.output.push(response.relayFd, response.relayLength);
+	if (response.closeAfterSend) conn.closeAfterSend = true;
+}
+
+void Server::acceptClients(int serverSocket, const config::Config* config) {
+	// A spare that could not be reopened after shedding is taken back once a descriptor is free.
+	if (_spareFd == -1) _spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	for (int i = 0; i < defaults::ACCEPT_BATCH; ++i) {
+		_addressSize = sizeof(_clientAddress);
+		_clientSocket =
+			socket::accept(serverSocket, reinterpret_cast<sockaddr*>(&_clientAddress),
+						   &_addressSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (_clientSocket == -1) {
+			// shedClient() makes calls of its own, so the cause is kept before it runs.
+			int error = errno;
+			if (error == EMFILE || error == ENFILE) shedClient(serverSocket);
+			if (error == EINTR || error == ECONNABORTED || error == EPROTO) continue;
+			return;
+		}
+		openClient(_clientSocket, config, _clientAddress);
+	}
 }
 
-void Server::sendResponse(int socketFd, const std::string& rawResponse) {
-	::write(socketFd, rawResponse.c_str(), rawResponse.size());
+void Server::openClient(int clientSocket, const config::Config* config, const sockaddr_in& peer) {
+	Connection* conn = admitClient(clientSocket);
+	if (!conn) {
+		close(clientSocket);
+		return;
+	}
+	conn->open(config, peer, &_buffers);
+	if (_uring)
+		armReceive(*conn);
+	else
+		_epollManager.add(conn->fd, Connection::kReadEvents, conn);
+	refreshTimer(*conn);
 }
 
-void Server::run() {
-	struct sigaction sa;
+// Out of descriptors: give up the spare so the pending client can be accepted and refused,
+// rather than leaving it queued and the level-triggered listener spinning.
+void Server::shedClient(int serverSocket) {
+	if (_spareFd == -1) return;
+	close(_spareFd);
+	int client = ::accept4(serverSocket, NULL, NULL, SOCK_CLOEXEC);
+	if (client != -1) close(client);
+	_spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (_spareFd == -1)
+		std::cerr << "[Warn] spare descriptor lost, retrying on the next accept" << std::endl;
+}
 
-	sa.sa_handler = cgi::ProcessManager::sigchldHandler;
-	sigemptyset(&sa.sa_mask);
-	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
-	if (sigaction(SIGCHLD, &sa, NULL) == -1) throw Exception("sigaction failed");
+Connection* Server::admitClient(int socketFd) {
+	if (_connections.full()) {
+		Connection* victim = _connections.get(_connections.leastRecentIdle());
+		if (_httpConfig.getConnectionOverflow() != config::HttpConfig::OverflowEvictIdle ||
+			!victim)
+			return NULL;
+		closeClient(*victim);
+	}
+	return _connections.insert(socketFd);
+}
+
+bool Server::flushOutput(Connection& conn) {
+	// An empty last piece, such as the end of a body cut short by a failed script, still
+	// closes a connection that is done.
+	if (!conn.sending()) {
+		if (!conn.closeAfterSend || _eventHandler.isWaitingCgi(conn)) return true;
+		closeClient(conn);
+		return false;
+	}
+
+	// A CGI response still being relayed keeps a closing connection open until its last piece.
+	OutputQueue::Status status =
+		_uring ? conn.output.submit(conn.fd, *_uring) : conn.output.flush(conn.fd);
+	if (status == OutputQueue::Failed ||
+		(status == OutputQueue::Drained && conn.closeAfterSend &&
+		 !_eventHandler.isWaitingCgi(conn))) {
+		closeClient(conn);
+		return false;
+	}
+
+	size_t pending = conn.output.pending();
+	bool paused = conn.readPaused;
+	if (!paused && pending >= defaults::OUTPUT_HIGH_WATER_MARK)
+		conn.readPaused = true;
+	else if (paused && pending <= defaults::OUTPUT_LOW_WATER_MARK)
+		conn.readPaused = false;
+	updateInterest(conn);
+
+	if (_eventHandler.isWaitingCgi(conn)) {
+		EventHandler::Result result = _eventHandler.handleOutputProgress(conn, _epollManager);
+		dispatchResult(result);
+		if (!_connections.contains(conn.fd)) return false;
+	}
+
+	if (!conn.sending() && _eventHandler.isIdle(conn)) _connections.markIdle(conn.fd);
+	return true;
+}
+
+void Server::updateInterest(Connection& conn) {
+	unsigned int events = 0;
+	if (!conn.readPaused && !conn.inputPaused && !conn.closeAfterSend)
+		events |= Connection::kReadEvents;
+	if (!conn.output.empty() && !conn.output.waiting()) events |= EPOLLOUT;
+	if (_uring) {
+		conn.events = events;
+		armReceive(conn);
+		return;
+	}
+	if (events == conn.events) return;
+	_epollManager.modify(conn.fd, events, &conn);
+	conn.events = events;
+}
+
+void Server::closeAfterDrain(Connection& conn) {
+	if (conn.output.empty() && !_eventHandler.isWaitingCgi(conn)) {
+		closeClient(conn);
+		return;
+	}
+	conn.closeAfterSend = true;
+	updateInterest(conn);
+}
+
+void Server::closeClient(Connection& conn) {
+	if (!_connections.contains(conn.fd)) return;
+	_connections.erase(conn.fd);
+	_timers.cancel(conn.fd);
+	_eventHandler.cleanup(conn, _epollManager);
+	if (!_uring) conn.output.clear();
+	_closing.push_back(conn.fd);
+}
+
+void Server::releaseClosed() {
+	for (size_t i = 0; i < _closing.size(); ++i) {
+		if (!_uring) {
+			_epollManager.remove(_closing[i]);
+			continue;
+		}
+		Connection& conn = *_connections.pooled(_closing[i]);
+		if (conn.receiving || conn.output.inFlight()) {
+			_uring->cancel(conn.fd);
+			conn.draining = true;
+		} else {
+			releaseConnection(conn);
+		}
+	}
+	_closing.clear();
+}
+
+void Server::run() {
+	// CGI children are reaped through their pidfds; without a handler an exited one stays a
+	// zombie until then, and nothing in the loop is interrupted by SIGCHLD.
+	signal(SIGCHLD, SIG_DFL);
+	signal(SIGPIPE, SIG_IGN);
+	_spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
 	_epollManager.init();
+	if (_httpConfig.getEventBackend() == config::HttpConfig::BackendIoUring) {
+		_uring = new UringManager();
+		if (_uring->init()) {
+			_uring->watch(_epollManager.fd());
+		} else {
+			delete _uring;
+			_uring = NULL;
+			std::cerr << "[Warn] io_uring unavailable, falling back to epoll" << std::endl;
+		}
+	}
+	_eventHandler.prepareCgi(_httpConfig, _configs, _epollManager);
 
-	for (std::map<int, config::Config>::iterator it = _configs.begin(); it != _configs.end();
-		 ++it) {
-		initServer(it->first);
+	if (_sharedListeners) {
+		for (std::map<int, const config::Config*>::const_iterator it = _serverSockets.begin();
+			 it != _serverSockets.end(); ++it)
+			registerListener(it->first);
+	} else {
+		for (std::map<int, config::Config>::const_iterator it = _configs.begin();
+			 it != _configs.end(); ++it)
+			initServer(it->first);
 	}
 	loop();
 }
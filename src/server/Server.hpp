@@ -12,34 +12,86 @@
 #include <vector>
 
 #include "../config/model/Config.hpp"
+#include "../config/model/HttpConfig.hpp"
 #include "../handler/EventHandler.hpp"
 #include "../http/model/Packet.hpp"
+#include "connection/ConnectionTable.hpp"
 #include "epoll/manager/EpollManager.hpp"
+#include "output/OutputQueue.hpp"
+#include "timer/TimerWheel.hpp"
+#include "uring/manager/UringManager.hpp"
 
 namespace server {
 	class Server {
 		private:
-			std::map<int, config::Config> _configs;
-			std::set<int> _serverSockets;
+			enum TimerKind {
+				HeaderTimer = 1,
+				BodyTimer,
+				KeepaliveTimer,
+				SendTimer,
+				CgiTimer
+			};
+
+			const std::map<int, config::Config>& _configs;
+			const config::HttpConfig& _httpConfig;
+			std::map<int, const config::Config*> _serverSockets;
+			bool _sharedListeners;
 			int _clientSocket;
-			int _socketOption;
-			int _addressSize;
-			sockaddr_in _serverAddress;
+			socklen_t _addressSize;
 			sockaddr_in _clientAddress;
+			int _spareFd;
 			EpollManager _epollManager;
+			UringManager* _uring;
+			bool _epollReady;
 			handler::EventHandler _eventHandler;
+			http::BufferPool _buffers;
+			ConnectionTable _connections;
+			TimerWheel _timers;
+			std::vector<TimerWheel::Expired> _expired;
+			std::vector<int> _closing;
+			std::vector<int> _resumed;
 
 			const config::Config* findConfig(int) const;
+			static unsigned long timeoutFor(const config::Config*, TimerKind);
 
 			void initServer(int);
+			void registerListener(int);
+			void acceptClients(int, const config::Config*);
+			void shedClient(int);
+			Connection* admitClient(int);
+			void openClient(int, const config::Config*, const sockaddr_in&);
 			void loop();
 			void handleEvents();
-			void sendResponse(int, const http::Packet&);
-			void sendResponse(int, const std::string&);
+			void handleClientEvent(Connection&, uint32_t);
+			void waitCompletions();
+			void handleCompletions();
+			void acceptCompleted(const UringManager::Completion&);
+			void receiveCompleted(const UringManager::Completion&);
+			void sendCompleted(const UringManager::Completion&);
+			void armReceive(Connection&);
+			void settleDrained(Connection&);
+			void releaseConnection(Connection&);
+			void handleCgiEvent(int, uint32_t);
+			void handleCgiConnectionEvent(int, uint32_t);
+			void settleCgi(Connection&, handler::EventHandler::Result&);
+			void dispatchResult(handler::EventHandler::Result&);
+			void refreshTimer(Connection&);
+			int nextTimeout() const;
+			void expireTimers();
+			void queueResponse(Connection&, handler::EventHandler::Response&);
+			bool flushOutput(Connection&);
+			void updateInterest(Connection&);
+			void closeAfterDrain(Connection&);
+			void closeClient(Connection&);
+			void releaseClosed();
 
 		public:
-			explicit Server(const std::map<int, config::Config>&);
+			Server(const std::map<int, config::Config>&, const config::HttpConfig&);
+			Server(const std::map<int, config::Config>&, const config::HttpConfig&,
+				   const std::set<int>&);
+			~Server();
 
+			static int listenOn(int, bool, int);
 			void run();
 	};
 }  // namespace server
@@ -0,0 +1,60 @@
+// Connection.cpp
+#include "Connection.hpp"
+
+#include <algorithm>
+
+#include "../../config/Defaults.hpp"
+
+namespace server {
+	Connection::Connection(int socket) :
+		fd(socket),
+		config(NULL),
+		requests(0),
+		cgiPending(false),
+		cgiDeadline(0),
+		cgiKeepAlive(false),
+		streamingBody(false),
+		inputPaused(false),
+		events(kReadEvents),
+		readPaused(false),
+		closeAfterSend(false),
+		receiving(false),
+		receiveCancelled(false),
+		draining(false) {
+		std::fill(reinterpret_cast<char*>(&peer), reinterpret_cast<char*>(&peer + 1), 0);
+	}
+
+	void Connection::open(const config::Config* serverConfig, const sockaddr_in& address,
+						  http::BufferPool* buffers) {
+		config = serverConfig;
+		peer = address;
+		parser.setBufferPool(buffers);
+		parser.reset();
+		parser.setMaxBodySize(static_cast<size_t>(serverConfig
+													  ? serverConfig->getClientMaxBodySize()
+													  : config::defaults::CLIENT_MAX_BODY_SIZE));
+		parser.setBodyBufferSize(static_cast<size_t>(
+			serverConfig ? serverConfig->getClientBodyBufferSize()
+						 : config::defaults::CLIENT_BODY_BUFFER_SIZE));
+		parser.setBodyTempPath(serverConfig ? serverConfig->getClientBodyTempPath()
+											: config::defaults::CLIENT_BODY_TEMP_PATH());
+		parser.setHeadFirst(serverConfig && !serverConfig->getCgiRequestBuffering());
+		requests = 0;
+		cgiPending = false;
+		cgiDeadline = 0;
+		cgiKeepAlive = false;
+		streamingBody = false;
+		inputPaused = false;
+		output.clear();
+		events = kReadEvents;
+		readPaused = false;
+		closeAfterSend = false;
+		receiving = false;
+		receiveCancelled = false;
+		draining = false;
+	}
+
+	bool Connection::sending() const {
+		return !output.empty() || events != kReadEvents;
+	}
+}  // namespace server
@@ -0,0 +1,50 @@
+// Connection.hpp
+#ifndef SERVER_CONNECTION_HPP
+#define SERVER_CONNECTION_HPP
+
+#include <netinet/in.h>
+#include <sys/epoll.h>
+
+#include "../../config/model/Config.hpp"
+#include "../../http/parser/Parser.hpp"
+#include "../output/OutputQueue.hpp"
+
+namespace server {
+	// Everything the event loop needs for one client, reached through epoll_event.data.ptr.
+	// Instances are pooled per fd by ConnectionTable and reused across accepts.
+	struct Connection {
+			static const unsigned int kReadEvents = EPOLLIN | EPOLLRDHUP;
+
+			int fd;
+			const config::Config* config;
+			sockaddr_in peer;
+			http::Parser parser;
+			long requests;
+			bool cgiPending;
+			// When the in-flight CGI request times out (TimerWheel::now() ms); 0 when it cannot.
+			unsigned long long cgiDeadline;
+			bool cgiKeepAlive;
+			bool streamingBody;
+			bool inputPaused;
+			OutputQueue output;
+			unsigned int events;
+			bool readPaused;
+			bool closeAfterSend;
+			// io_uring only: a multishot recv is armed, a cancel for it is pending, and the
+			// connection is closed but waits for its requests to come back before its fd goes.
+			bool receiving;
+			bool receiveCancelled;
+			bool draining;
+
+			explicit Connection(int);
+
+			void open(const config::Config*, const sockaddr_in&, http::BufferPool*);
+			bool sending() const;
+
+		private:
+			Connection(const Connection&);
+			Connection& operator=(const Connection&);
+	};
+}  // namespace server
+
+#endif
@@ -0,0 +1,105 @@
+// ConnectionTable.cpp
+#include "ConnectionTable.hpp"
+
+namespace server {
+	ConnectionTable::ConnectionTable(int limit) : _count(0), _limit(limit) {}
+
+	ConnectionTable::~ConnectionTable() {
+		for (size_t i = 0; i < _slots.size(); ++i) delete _slots[i].conn;
+	}
+
+	int ConnectionTable::size() const {
+		return _count;
+	}
+
+	bool ConnectionTable::full() const {
+		return _count >= _limit;
+	}
+
+	bool ConnectionTable::contains(int fd) const {
+		return fd >= 0 && fd < static_cast<int>(_slots.size()) && _slots[fd].used;
+	}
+
+	Connection* ConnectionTable::get(int fd) const {
+		return contains(fd) ? _slots[fd].conn : NULL;
+	}
+
+	// The instance kept for fd whether or not it is in use, for a closed connection whose
+	// io_uring requests are still outstanding.
+	Connection* ConnectionTable::pooled(int fd) const {
+		return fd >= 0 && fd < static_cast<int>(_slots.size()) ? _slots[fd].conn : NULL;
+	}
+
+	bool ConnectionTable::isIdle(int fd) const {
+		return contains(fd) && _slots[fd].idle;
+	}
+
+	ConnectionTable::List& ConnectionTable::listOf(const Slot& slot) {
+		return slot.idle ? _idle : _active;
+	}
+
+	void ConnectionTable::link(int fd) {
+		Slot& slot = _slots[fd];
+		List& list = listOf(slot);
+		slot.prev = list.tail;
+		slot.next = -1;
+		if (list.tail != -1)
+			_slots[list.tail].next = fd;
+		else
+			list.head = fd;
+		list.tail = fd;
+	}
+
+	void ConnectionTable::unlink(int fd) {
+		Slot& slot = _slots[fd];
+		List& list = listOf(slot);
+		if (slot.prev != -1)
+			_slots[slot.prev].next = slot.next;
+		else
+			list.head = slot.next;
+		if (slot.next != -1)
+			_slots[slot.next].prev = slot.prev;
+		else
+			list.tail = slot.prev;
+		slot.prev = -1;
+		slot.next = -1;
+	}
+
+	Connection* ConnectionTable::insert(int fd) {
+		if (fd < 0 || full() || contains(fd)) return NULL;
+		if (fd >= static_cast<int>(_slots.size())) _slots.resize(fd + 1);
+		Slot& slot = _slots[fd];
+		if (!slot.conn) slot.conn = new Connection(fd);
+		slot.used = true;
+		slot.idle = false;
+		link(fd);
+		_count++;
+		return slot.conn;
+	}
+
+	void ConnectionTable::erase(int fd) {
+		if (!contains(fd)) return;
+		unlink(fd);
+		_slots[fd].used = false;
+		_slots[fd].idle = false;
+		_count--;
+	}
+
+	void ConnectionTable::markActive(int fd) {
+		if (!contains(fd)) return;
+		unlink(fd);
+		_slots[fd].idle = false;
+		link(fd);
+	}
+
+	void ConnectionTable::markIdle(int fd) {
+		if (!contains(fd)) return;
+		unlink(fd);
+		_slots[fd].idle = true;
+		link(fd);
+	}
+
+	int ConnectionTable::leastRecentIdle() const {
+		return _idle.head;
+	}
+}  // namespace server
@@ -0,0 +1,60 @@
+// ConnectionTable.hpp
+#ifndef SERVER_CONNECTION_TABLE_HPP
+#define SERVER_CONNECTION_TABLE_HPP
+
+#include <vector>
+
+#include "Connection.hpp"
+
+namespace server {
+	class ConnectionTable {
+		private:
+			struct Slot {
+					Connection* conn;
+					bool used;
+					bool idle;
+					int prev;
+					int next;
+
+					Slot() : conn(NULL), used(false), idle(false), prev(-1), next(-1) {}
+			};
+			struct List {
+					int head;
+					int tail;
+
+					List() : head(-1), tail(-1) {}
+			};
+
+			std::vector<Slot> _slots;
+			List _active;
+			List _idle;
+			int _count;
+			int _limit;
+
+			List& listOf(const Slot&);
+			void link(int);
+			void unlink(int);
+
+			ConnectionTable(const ConnectionTable&);
+			ConnectionTable& operator=(const ConnectionTable&);
+
+		public:
+			explicit ConnectionTable(int);
+			~ConnectionTable();
+
+			int size() const;
+			bool full() const;
+			bool contains(int) const;
+			bool isIdle(int) const;
+
+			Connection* get(int) const;
+			Connection* pooled(int) const;
+			Connection* insert(int);
+			void erase(int);
+			void markActive(int);
+			void markIdle(int);
+			int leastRecentIdle() const;
+	};
+}  // namespace server
+
+#endif
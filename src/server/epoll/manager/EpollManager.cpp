@@ -26,6 +26,15 @@ const epoll_event& EpollManager::eventAt(int index) const {
 	return _events[index];
 }
 
+bool EpollManager::isRegistered(int fd) const {
+	return fd >= 0 && fd < static_cast<int>(_registered.size()) && _registered[fd];
+}
+
+void EpollManager::setRegistered(int fd, bool registered) {
+	if (fd >= static_cast<int>(_registered.size())) _registered.resize(fd + 1, false);
+	_registered[fd] = registered;
+}
+
 void EpollManager::init() {
 	_epollFd = epoll_create(kMaxEvents);
 	if (_epollFd == -1) throw EpollException("create");
@@ -33,40 +42,55 @@ void EpollManager::init() {
 }
 
 void EpollManager::add(int fd) {
-	if (!_counter.addFd(fd)) {
-		remove(_counter.popFd());
-		_counter.addFd(fd);
-	}
-	_event.events = EPOLLIN | EPOLLRDHUP;
-	_event.data.fd = fd;
-	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &_event) == -1) {
-		throw EpollException("ctl add");
-	}
+	add(fd, EPOLLIN | EPOLLRDHUP);
 }
 
 void EpollManager::add(int fd, unsigned int events) {
-	if (!_counter.addFd(fd)) {
-		remove(_counter.popFd());
-		_counter.addFd(fd);
-	}
+	control(EPOLL_CTL_ADD, fd, events, (static_cast<uint64_t>(fd) << 1) | 1);
+	setRegistered(fd, true);
+}
+
+void EpollManager::add(int fd, unsigned int events, void* context) {
+	control(EPOLL_CTL_ADD, fd, events, reinterpret_cast<uintptr_t>(context));
+	setRegistered(fd, true);
+}
+
+void EpollManager::modify(int fd, unsigned int events) {
+	control(EPOLL_CTL_MOD, fd, events, (static_cast<uint64_t>(fd) << 1) | 1);
+}
+
+void EpollManager::modify(int fd, unsigned int events, void* context) {
+	control(EPOLL_CTL_MOD, fd, events, reinterpret_cast<uintptr_t>(context));
+}
+
+void EpollManager::control(int op, int fd, unsigned int events, uint64_t data) {
 	_event.events = events;
-	_event.data.fd = fd;
-	if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &_event) == -1) {
-		throw EpollException("ctl add");
+	_event.data.u64 = data;
+	if (epoll_ctl(_epollFd, op, fd, &_event) == -1) {
+		throw EpollException(op == EPOLL_CTL_ADD ? "ctl add" : "ctl mod");
 	}
 }
 
+int EpollManager::fdOf(const epoll_event& event) {
+	return (event.data.u64 & 1) ? static_cast<int>(event.data.u64 >> 1) : -1;
+}
+
+void* EpollManager::contextOf(const epoll_event& event) {
+	return (event.data.u64 & 1) ? NULL : event.data.ptr;
+}
+
 void EpollManager::remove(int fd) {
-	if (_counter.deleteFd(fd)) {
-		if (epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL) == -1) {
-			throw EpollException("ctl del");
-		}
+	if (!isRegistered(fd)) return;
+	setRegistered(fd, false);
+	if (epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL) == -1) {
 		close(fd);
+		throw EpollException("ctl del");
 	}
+	close(fd);
 }
 
-void EpollManager::wait() {
-	_eventCount = epoll_wait(_epollFd, _events.data(), kMaxEvents, 1000);
+void EpollManager::wait(int timeout) {
+	_eventCount = epoll_wait(_epollFd, _events.data(), kMaxEvents, timeout);
 	if (_eventCount == -1) {
 		if (errno == EINTR) {
 			_eventCount = 0;
@@ -2,13 +2,13 @@
 #ifndef SERVER_EPOLL_MANAGER_HPP
 #define SERVER_EPOLL_MANAGER_HPP
 
+#include <stdint.h>
 #include <sys/epoll.h>
 #include <unistd.h>
 
 #include <vector>
 
 #include "../../Defaults.hpp"
-#include "../counter/EpollCounter.hpp"
 
 namespace server {
 	class EpollManager {
@@ -18,7 +18,11 @@ namespace server {
 			int _eventCount;
 			epoll_event _event;
 			std::vector<epoll_event> _events;
-			EpollCounter _counter;
+			std::vector<bool> _registered;
+
+			bool isRegistered(int) const;
+			void setRegistered(int, bool);
+			void control(int, int, unsigned int, uint64_t);
 
 		public:
 			EpollManager();
@@ -30,8 +34,16 @@ namespace server {
 			void init();
 			void add(int);
 			void add(int, unsigned int);
+			void add(int, unsigned int, void*);
+			void modify(int, unsigned int);
+			void modify(int, unsigned int, void*);
 			void remove(int);
-			void wait();
+			void wait(int);
+
+			// Plain registrations carry the fd shifted left with the low bit set; context
+			// registrations carry the (aligned, so low bit clear) pointer itself.
+			static int fdOf(const epoll_event&);
+			static void* contextOf(const epoll_event&);
 	};
 }  // namespace server
 
@@ -0,0 +1,189 @@
+// Master.cpp
+#include "Master.hpp"
+
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+
+#include "../Server.hpp"
+#include "../exception/Exception.hpp"
+
+using namespace server;
+
+namespace {
+	const size_t kRespawnBurst = 5;
+	const time_t kRespawnWindow = 10;
+}  // namespace
+
+volatile sig_atomic_t Master::_stopRequested = 0;
+
+Master::Master(const std::map<int, config::Config>& configs, const config::HttpConfig& httpConfig) :
+	_configs(configs), _httpConfig(httpConfig) {}
+
+void Master::stopHandler(int sig) {
+	(void) sig;
+	_stopRequested = 1;
+}
+
+void Master::installSignals() const {
+	struct sigaction sa;
+
+	sa.sa_handler = Master::stopHandler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	if (sigaction(SIGTERM, &sa, NULL) == -1 || sigaction(SIGINT, &sa, NULL) == -1)
+		throw Exception("sigaction failed");
+}
+
+// Replacements are immediate while they are rare; past kRespawnBurst within kRespawnWindow
+// seconds each one waits a second, so a worker that cannot start does not spin.
+void Master::throttleRespawn(const char* what) {
+	time_t now = time(NULL);
+	while (!_respawns.empty() && now - _respawns.front() >= kRespawnWindow) _respawns.pop_front();
+	if (_respawns.size() >= kRespawnBurst) {
+		std::cerr << "[Warn] " << what << " keep exiting, delaying the next restart" << std::endl;
+		sleep(1);
+	}
+	_respawns.push_back(time(NULL));
+}
+
+void Master::spawnWorker() {
+	pid_t pid = fork();
+	if (pid == -1) throw Exception("fork");
+	if (pid == 0) {
+		// runWorker() only returns once the servers have stopped on an error.
+		runWorker();
+		std::exit(1);
+	}
+	_workers.insert(pid);
+}
+
+void Master::runWorker() {
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGINT, SIG_DFL);
+	try {
+		runServers();
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		std::exit(1);
+	}
+}
+
+void Master::runServers() {
+	if (_httpConfig.getWorkerThreads() > 1) {
+		runThreads();
+		return;
+	}
+	Server server(_configs, _httpConfig);
+	server.run();
+}
+
+void* Master::threadMain(void* arg) {
+	Master* master = static_cast<Master*>(arg);
+	try {
+		Server server(master->_configs, master->_httpConfig, master->_listeners);
+		server.run();
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+	}
+	pthread_mutex_lock(&master->_threadLock);
+	master->_exitedThreads.push_back(pthread_self());
+	pthread_cond_signal(&master->_threadExited);
+	pthread_mutex_unlock(&master->_threadLock);
+	return NULL;
+}
+
+bool Master::startThread(size_t& running) {
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, Master::threadMain, this) != 0) {
+		std::cerr << "[Error] Server thread create Error" << std::endl;
+		return false;
+	}
+	++running;
+	return true;
+}
+
+void Master::runThreads() {
+	bool reusePort = _httpConfig.getWorkerProcesses() > 1;
+	for (std::map<int, config::Config>::const_iterator it = _configs.begin(); it != _configs.end();
+		 ++it)
+		_listeners.insert(Server::listenOn(it->first, reusePort, it->second.getListenBacklog()));
+
+	// Where SIGCHLD reports CGI exits, a server thread's signalfd must be the one to take it.
+	sigset_t child;
+	sigemptyset(&child);
+	sigaddset(&child, SIGCHLD);
+	pthread_sigmask(SIG_BLOCK, &child, NULL);
+	pthread_mutex_init(&_threadLock, NULL);
+	pthread_cond_init(&_threadExited, NULL);
+	_respawns.clear();
+	size_t running = 0;
+	for (int i = 0; i < _httpConfig.getWorkerThreads(); ++i)
+		if (!startThread(running)) break;
+
+	// A server thread only returns when its loop has failed; it is joined and replaced.
+	while (running > 0) {
+		pthread_mutex_lock(&_threadLock);
+		while (_exitedThreads.empty()) pthread_cond_wait(&_threadExited, &_threadLock);
+		pthread_t thread = _exitedThreads.front();
+		_exitedThreads.pop_front();
+		pthread_mutex_unlock(&_threadLock);
+		pthread_join(thread, NULL);
+		--running;
+
+		std::cerr << "[Warn] server thread stopped, restarting it" << std::endl;
+		throttleRespawn("server threads");
+		startThread(running);
+	}
+	std::cerr << "[Error] no server thread left running" << std::endl;
+
+	for (std::set<int>::iterator it = _listeners.begin(); it != _listeners.end(); ++it) close(*it);
+	_listeners.clear();
+}
+
+void Master::supervise() {
+	while (!_workers.empty()) {
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid == -1) {
+			if (errno != EINTR) break;
+			if (_stopRequested) stopWorkers();
+			continue;
+		}
+		if (_workers.erase(pid) == 0 || _stopRequested) continue;
+
+		// Workers only end when told to, so any other exit is replaced.
+		if (WIFSIGNALED(status))
+			std::cerr << "[Warn] worker " << pid << " exited on signal " << WTERMSIG(status)
+					  << ", respawning" << std::endl;
+		else
+			std::cerr << "[Warn] worker " << pid << " exited with status " << WEXITSTATUS(status)
+					  << ", respawning" << std::endl;
+		throttleRespawn("workers");
+		if (_stopRequested) {
+			stopWorkers();
+			continue;
+		}
+		spawnWorker();
+	}
+}
+
+void Master::stopWorkers() const {
+	for (std::set<pid_t>::const_iterator it = _workers.begin(); it != _workers.end(); ++it)
+		kill(*it, SIGTERM);
+}
+
+void Master::run() {
+	if (_httpConfig.getWorkerProcesses() <= 1) {
+		runServers();
+		return;
+	}
+
+	installSignals();
+	for (int i = 0; i < _httpConfig.getWorkerProcesses(); ++i) spawnWorker();
+	supervise();
+}
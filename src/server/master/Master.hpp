@@ -0,0 +1,51 @@
+// Master.hpp
+#ifndef SERVER_MASTER_HPP
+#define SERVER_MASTER_HPP
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include "../../config/model/Config.hpp"
+#include "../../config/model/HttpConfig.hpp"
+
+namespace server {
+	class Master {
+		private:
+			static volatile sig_atomic_t _stopRequested;
+
+			std::map<int, config::Config> _configs;
+			config::HttpConfig _httpConfig;
+			std::set<pid_t> _workers;
+			std::set<int> _listeners;
+			std::deque<time_t> _respawns;
+			pthread_mutex_t _threadLock;
+			pthread_cond_t _threadExited;
+			std::deque<pthread_t> _exitedThreads;
+
+			static void stopHandler(int);
+			static void* threadMain(void*);
+
+			void installSignals() const;
+			void throttleRespawn(const char*);
+			void spawnWorker();
+			void runWorker();
+			void runServers();
+			void runThreads();
+			bool startThread(size_t&);
+			void supervise();
+			void stopWorkers() const;
+
+		public:
+			Master(const std::map<int, config::Config>&, const config::HttpConfig&);
+
+			void run();
+	};
+}  // namespace server
+
+#endif
@@ -0,0 +1,344 @@
+// OutputQueue.cpp
+#include "OutputQueue.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "../Defaults.hpp"
+
+namespace server {
+	OutputQueue::OutputQueue() :
+		_offset(0),
+		_pending(0),
+		_piped(0),
+		_pipeSize(0),
+		_relays(0),
+		_waiting(false),
+		_stepCount(0),
+		_inFlight(0),
+		_failed(false),
+		_writeBlocked(false),
+		_discarded(false),
+		_chain(NULL) {
+		_pipe[0] = _pipe[1] = -1;
+		std::memset(&_message, 0, sizeof(_message));
+	}
+
+	OutputQueue::~OutputQueue() {
+		clear();
+	}
+
+	// Bytes held in memory or in the relay pipe; a relay's source counts only once pulled.
+	size_t OutputQueue::pending() const {
+		return _pending;
+	}
+
+	bool OutputQueue::empty() const {
+		return _chunks.empty();
+	}
+
+	bool OutputQueue::relaying() const {
+		return _relays > 0;
+	}
+
+	// The last flush stopped because a relay's source had nothing to give, not because the
+	// socket was full.
+	bool OutputQueue::waiting() const {
+		return _waiting;
+	}
+
+	// Relays go through one pipe per connection, opened on first use and kept until clear().
+	bool OutputQueue::openRelay() {
+		if (_pipe[0] != -1) return true;
+		return pipe2(_pipe, O_NONBLOCK | O_CLOEXEC) == 0;
+	}
+
+	void OutputQueue::push(const std::string& data) {
+		if (data.empty()) return;
+		_chunks.push_back(Chunk());
+		_chunks.back().data = data;
+		_pending += data.size();
+	}
+
+	void OutputQueue::push(std::vector<unsigned char>& bytes) {
+		if (bytes.empty()) return;
+		_chunks.push_back(Chunk());
+		_chunks.back().bytes.swap(bytes);
+		_pending += _chunks.back().bytes.size();
+	}
+
+	void OutputQueue::push(const http::FileRegion& file) {
+		if (!file.isOpen() || file.getLength() == 0) return;
+		_chunks.push_back(Chunk());
+		_chunks.back().file = file;
+		_pending += file.getLength();
+	}
+
+	ssize_t OutputQueue::sendFile(int fd, const Chunk& chunk) {
+		size_t remain = chunk.size() - _offset;
+		off_t position = chunk.file.getOffset() + static_cast<off_t>(_offset);
+		if (remain > defaults::SENDFILE_CHUNK_SIZE) remain = defaults::SENDFILE_CHUNK_SIZE;
+
+		ssize_t sent = ::sendfile(fd, chunk.file.getFd(), &position, remain);
+		if (sent == 0) {
+			errno = EIO;
+			return -1;
+		}
+		return sent;
+	}
+
+	void OutputQueue::push(int source, size_t length) {
+		if (source == -1 || length == 0) return;
+		_chunks.push_back(Chunk());
+		_chunks.back().source = source;
+		_chunks.back().length = length;
+		_relays++;
+	}
+
+	// Pulls the next bytes of a relayed body from its source into the pipe; a source that ends
+	// early fails the queue, since the length was announced.
+	ssize_t OutputQueue::pullRelay(const Chunk& chunk) {
+		size_t want = std::min(chunk.length - _offset, defaults::SENDFILE_CHUNK_SIZE);
+		ssize_t pulled =
+			::splice(chunk.source, NULL, _pipe[1], NULL, want, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (pulled == 0) errno = EPIPE;
+		if (pulled <= 0) {
+			_waiting = errno == EAGAIN || errno == EWOULDBLOCK;
+			return -1;
+		}
+		_piped = static_cast<size_t>(pulled);
+		_pending += _piped;
+		return pulled;
+	}
+
+	// Moves a relayed body from its source to the socket through the pipe, so it never enters
+	// user space. More is pulled only once the pipe has been emptied into the socket.
+	ssize_t OutputQueue::sendRelay(int fd, const Chunk& chunk) {
+		if (_piped == 0 && pullRelay(chunk) == -1) return -1;
+		ssize_t sent = ::splice(_pipe[0], NULL, fd, NULL, _piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (sent > 0) _piped -= static_cast<size_t>(sent);
+		return sent;
+	}
+
+	// Points iov at the buffered chunks at the head of the queue; returns how many.
+	int OutputQueue::gatherBuffers(iovec* iov) {
+		int count = 0;
+		size_t skip = _offset;
+
+		for (std::deque<Chunk>::const_iterator it = _chunks.begin();
+			 it != _chunks.end() && count < defaults::WRITEV_MAX_IOVEC && it->buffered();
+			 ++it) {
+			iov[count].iov_base = const_cast<char*>(it->base() + skip);
+			iov[count].iov_len = it->size() - skip;
+			skip = 0;
+			++count;
+		}
+		return count;
+	}
+
+	ssize_t OutputQueue::sendBuffers(int fd) {
+		iovec iov[defaults::WRITEV_MAX_IOVEC];
+		return ::writev(fd, iov, gatherBuffers(iov));
+	}
+
+	void OutputQueue::advance(size_t sent) {
+		_pending -= sent;
+		while (sent > 0) {
+			size_t remain = _chunks.front().size() - _offset;
+			if (sent < remain) {
+				_offset += sent;
+				return;
+			}
+			sent -= remain;
+			if (_chunks.front().source != -1) _relays--;
+			_chunks.pop_front();
+			_offset = 0;
+		}
+	}
+
+	OutputQueue::Status OutputQueue::flush(int fd) {
+		_waiting = false;
+		while (!_chunks.empty()) {
+			const Chunk& front = _chunks.front();
+			ssize_t sent = front.source != -1 ? sendRelay(fd, front)
+						   : front.file.isOpen() ? sendFile(fd, front)
+												 : sendBuffers(fd);
+			if (sent > 0) {
+				advance(static_cast<size_t>(sent));
+				continue;
+			}
+			if (sent == -1 && errno == EINTR) continue;
+			if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return Blocked;
+			return Failed;
+		}
+		return Drained;
+	}
+
+	bool OutputQueue::inFlight() const {
+		return _inFlight > 0;
+	}
+
+	// Each step is linked to the one before, so it runs only once that one has fully succeeded.
+	io_uring_sqe* OutputQueue::addStep(UringManager& ring, Step step, unsigned char opcode,
+									   int fd) {
+		if (_stepCount > 0) _chain->flags |= IOSQE_IO_LINK;
+		_chain = ring.prepare(opcode, fd, UringManager::tag(fd, UringManager::SendOp, _stepCount));
+		_steps[_stepCount++] = step;
+		return _chain;
+	}
+
+	void OutputQueue::addPull(UringManager& ring, int fd, const http::FileRegion& file,
+							  size_t offset) {
+		io_uring_sqe* sqe = addStep(ring, PullStep, IORING_OP_SPLICE, fd);
+		sqe->fd = _pipe[1];
+		sqe->off = static_cast<uint64_t>(-1);
+		sqe->splice_fd_in = file.getFd();
+		sqe->splice_off_in = static_cast<uint64_t>(file.getOffset() + static_cast<off_t>(offset));
+		sqe->len = static_cast<uint32_t>(std::min(file.getLength() - offset, pipeSize()));
+		sqe->splice_flags = SPLICE_F_MOVE;
+	}
+
+	void OutputQueue::addPush(UringManager& ring, int fd, size_t length) {
+		io_uring_sqe* sqe = addStep(ring, PushStep, IORING_OP_SPLICE, fd);
+		sqe->off = static_cast<uint64_t>(-1);
+		sqe->splice_fd_in = _pipe[0];
+		sqe->splice_off_in = static_cast<uint64_t>(-1);
+		sqe->len = static_cast<uint32_t>(length);
+		sqe->splice_flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+	}
+
+	// io_uring counterpart of flush(): the head of the queue goes out as one linked chain, the
+	// buffered chunks in a sendmsg and a file's next bytes spliced into the pipe and on to the
+	// socket, and the next chain is built once complete() has seen all of this one. A relay's
+	// source is still pulled here, so a script with nothing to give leaves the queue waiting
+	// just as flush() does.
+	OutputQueue::Status OutputQueue::submit(int fd, UringManager& ring) {
+		if (_inFlight > 0) return Blocked;
+		if (_failed) return Failed;
+		_waiting = false;
+		if (_chunks.empty()) return Drained;
+
+		const Chunk& front = _chunks.front();
+		bool buffered = _piped == 0 && front.buffered();
+		if (!buffered && !openRelay()) return Failed;
+		if (_piped == 0 && front.source != -1 && pullRelay(front) == -1)
+			return _waiting ? Blocked : Failed;
+
+		ring.reserve(kMaxSteps);
+		_stepCount = 0;
+		if (_writeBlocked) {
+			addStep(ring, PollStep, IORING_OP_POLL_ADD, fd)->poll32_events = POLLOUT;
+			_writeBlocked = false;
+		}
+		if (_piped > 0) {
+			addPush(ring, fd, _piped);
+		} else if (front.file.isOpen()) {
+			addPull(ring, fd, front.file, _offset);
+			addPush(ring, fd, std::min(front.size() - _offset, pipeSize()));
+		} else {
+			int count = gatherBuffers(_iov);
+			_message.msg_iov = _iov;
+			_message.msg_iovlen = static_cast<size_t>(count);
+			io_uring_sqe* sqe = addStep(ring, SendStep, IORING_OP_SENDMSG, fd);
+			sqe->addr = reinterpret_cast<uintptr_t>(&_message);
+			sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+			// A response head is followed straight away by the file it announces.
+			if (static_cast<size_t>(count) < _chunks.size() && _chunks[count].file.isOpen() &&
+				openRelay()) {
+				addPull(ring, fd, _chunks[count].file, 0);
+				addPush(ring, fd, std::min(_chunks[count].size(), pipeSize()));
+			}
+		}
+		_inFlight = _stepCount;
+		return Blocked;
+	}
+
+	// Takes one completion of the chain in flight and returns true once all of it is back. A
+	// step cancelled because an earlier one fell short changes nothing; what it would have
+	// moved is left for the next chain.
+	bool OutputQueue::complete(int step, int result) {
+		if (_inFlight == 0 || step < 0 || step >= _stepCount) return false;
+		_inFlight--;
+		if (_discarded) {
+			if (_inFlight > 0) return false;
+			_retired.clear();
+			closePipe();
+			_discarded = false;
+			return true;
+		}
+		if (result == -ECANCELED) return _inFlight == 0;
+
+		switch (_steps[step]) {
+			case PollStep:
+				if (result < 0) _failed = true;
+				break;
+			case SendStep:
+				if (result < 0)
+					_failed = true;
+				else
+					advance(static_cast<size_t>(result));
+				break;
+			case PullStep:
+				if (result > 0)
+					_piped += static_cast<size_t>(result);
+				else if (result != -EAGAIN)
+					_failed = true;
+				break;
+			case PushStep:
+				if (result == -EAGAIN) {
+					_writeBlocked = true;
+				} else if (result <= 0) {
+					_failed = true;
+				} else {
+					_piped -= static_cast<size_t>(result);
+					advance(static_cast<size_t>(result));
+				}
+				break;
+		}
+		return _inFlight == 0;
+	}
+
+	void OutputQueue::closePipe() {
+		if (_pipe[0] != -1) {
+			close(_pipe[0]);
+			close(_pipe[1]);
+			_pipe[0] = _pipe[1] = -1;
+		}
+		_piped = 0;
+		_pipeSize = 0;
+	}
+
+	// A linked pull that falls short of what was asked breaks its chain, so a pull never asks
+	// for more than the pipe holds. The pipe is grown to a sendfile() chunk where allowed.
+	size_t OutputQueue::pipeSize() {
+		if (_pipeSize == 0) {
+			int size =
+				fcntl(_pipe[1], F_SETPIPE_SZ, static_cast<int>(defaults::SENDFILE_CHUNK_SIZE));
+			if (size == -1) size = fcntl(_pipe[1], F_GETPIPE_SZ);
+			_pipeSize = size > 0 ? static_cast<size_t>(size) : defaults::PIPE_CHUNK_SIZE;
+		}
+		return _pipeSize;
+	}
+
+	// A chain still in flight reads the chunks and the pipe, so they are kept until it is back.
+	void OutputQueue::clear() {
+		if (_inFlight > 0 && !_discarded) {
+			_retired.swap(_chunks);
+			_discarded = true;
+		}
+		_chunks.clear();
+		_offset = 0;
+		_pending = 0;
+		_relays = 0;
+		_waiting = false;
+		_failed = false;
+		_writeBlocked = false;
+		if (!_discarded) closePipe();
+	}
+}  // namespace server
@@ -0,0 +1,118 @@
+// OutputQueue.hpp
+#ifndef SERVER_OUTPUT_QUEUE_HPP
+#define SERVER_OUTPUT_QUEUE_HPP
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "../../http/model/FileRegion.hpp"
+#include "../Defaults.hpp"
+#include "../uring/manager/UringManager.hpp"
+
+namespace server {
+	class OutputQueue {
+		public:
+			enum Status {
+				Drained,
+				Blocked,
+				Failed
+			};
+
+		private:
+			struct Chunk {
+					std::string data;
+					std::vector<unsigned char> bytes;
+					http::FileRegion file;
+					int source;
+					size_t length;
+
+					Chunk() : source(-1), length(0) {}
+
+					bool buffered() const {
+						return source == -1 && !file.isOpen();
+					}
+					size_t size() const {
+						if (source != -1) return length;
+						if (file.isOpen()) return file.getLength();
+						return bytes.empty() ? data.size() : bytes.size();
+					}
+					const char* base() const {
+						if (!bytes.empty()) return reinterpret_cast<const char*>(&bytes[0]);
+						return data.data();
+					}
+			};
+
+			// One request of an io_uring chain; a chain holds at most a poll, a send and a
+			// pull and push through the pipe.
+			enum Step {
+				PollStep,
+				SendStep,
+				PullStep,
+				PushStep
+			};
+			static const int kMaxSteps = 4;
+
+			std::deque<Chunk> _chunks;
+			size_t _offset;
+			size_t _pending;
+			int _pipe[2];
+			size_t _piped;
+			size_t _pipeSize;
+			int _relays;
+			bool _waiting;
+			Step _steps[kMaxSteps];
+			int _stepCount;
+			int _inFlight;
+			bool _failed;
+			bool _writeBlocked;
+			bool _discarded;
+			io_uring_sqe* _chain;
+			std::deque<Chunk> _retired;
+			iovec _iov[defaults::WRITEV_MAX_IOVEC];
+			msghdr _message;
+
+			OutputQueue(const OutputQueue&);
+			OutputQueue& operator=(const OutputQueue&);
+
+			ssize_t sendFile(int, const Chunk&);
+			ssize_t pullRelay(const Chunk&);
+			ssize_t sendRelay(int, const Chunk&);
+			int gatherBuffers(iovec*);
+			ssize_t sendBuffers(int);
+			void advance(size_t);
+			void closePipe();
+			size_t pipeSize();
+
+			io_uring_sqe* addStep(UringManager&, Step, unsigned char, int);
+			void addPull(UringManager&, int, const http::FileRegion&, size_t);
+			void addPush(UringManager&, int, size_t);
+
+		public:
+			OutputQueue();
+			~OutputQueue();
+
+			size_t pending() const;
+			bool empty() const;
+			bool relaying() const;
+			bool waiting() const;
+			bool openRelay();
+
+			void push(const std::string&);
+			void push(std::vector<unsigned char>&);
+			void push(const http::FileRegion&);
+			void push(int, size_t);
+			Status flush(int);
+			bool inFlight() const;
+			Status submit(int, UringManager&);
+			bool complete(int, int);
+			void clear();
+	};
+}  // namespace server
+
+#endif
@@ -0,0 +1,131 @@
+// TimerWheel.cpp
+#include "TimerWheel.hpp"
+
+#include <time.h>
+
+namespace server {
+	TimerWheel::TimerWheel(unsigned long tickMs) : _current(0), _tickMs(tickMs), _count(0) {
+		for (int level = 0; level < kLevels; ++level)
+			for (int slot = 0; slot < kSlots; ++slot) _heads[level][slot] = -1;
+		_current = now() / _tickMs;
+	}
+
+	unsigned long long TimerWheel::now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<unsigned long long>(ts.tv_sec) * 1000ULL +
+			   static_cast<unsigned long long>(ts.tv_nsec) / 1000000ULL;
+	}
+
+	bool TimerWheel::isArmed(int fd) const {
+		return fd >= 0 && fd < static_cast<int>(_nodes.size()) && _nodes[fd].level != -1;
+	}
+
+	void TimerWheel::place(int fd) {
+		Node& node = _nodes[fd];
+		unsigned long long delta = node.expires - _current;
+		int level = 0;
+
+		while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) ++level;
+		if (delta >= (1ULL << (kSlotBits * kLevels))) {
+			node.expires = _current + (1ULL << (kSlotBits * kLevels)) - 1;
+		}
+		node.level = level;
+		node.slot = static_cast<int>((node.expires >> (kSlotBits * level)) & kSlotMask);
+		node.prev = -1;
+		node.next = _heads[level][node.slot];
+		if (node.next != -1) _nodes[node.next].prev = fd;
+		_heads[level][node.slot] = fd;
+	}
+
+	void TimerWheel::unlink(int fd) {
+		Node& node = _nodes[fd];
+		if (node.prev != -1)
+			_nodes[node.prev].next = node.next;
+		else
+			_heads[node.level][node.slot] = node.next;
+		if (node.next != -1) _nodes[node.next].prev = node.prev;
+		node.prev = -1;
+		node.next = -1;
+		node.level = -1;
+		node.slot = -1;
+	}
+
+	void TimerWheel::cascade(int level, int slot) {
+		int fd = _heads[level][slot];
+		_heads[level][slot] = -1;
+		while (fd != -1) {
+			int next = _nodes[fd].next;
+			place(fd);
+			fd = next;
+		}
+	}
+
+	void TimerWheel::schedule(int fd, int kind, unsigned long delayMs, unsigned long long nowMs) {
+		if (fd < 0) return;
+		if (fd >= static_cast<int>(_nodes.size())) _nodes.resize(fd + 1);
+		if (isArmed(fd))
+			unlink(fd);
+		else
+			_count++;
+
+		unsigned long long expires = (nowMs + delayMs + _tickMs - 1) / _tickMs;
+		_nodes[fd].expires = expires > _current ? expires : _current + 1;
+		_nodes[fd].kind = kind;
+		place(fd);
+	}
+
+	void TimerWheel::cancel(int fd) {
+		if (!isArmed(fd)) return;
+		unlink(fd);
+		_nodes[fd].kind = 0;
+		_count--;
+	}
+
+	int TimerWheel::kindOf(int fd) const {
+		return isArmed(fd) ? _nodes[fd].kind : 0;
+	}
+
+	int TimerWheel::nextTimeout(unsigned long long nowMs) const {
+		if (_count == 0) return -1;
+
+		unsigned long long deadline = (_current | kSlotMask) + 1;
+		for (unsigned long long tick = _current + 1; tick < deadline; ++tick) {
+			if (_heads[0][tick & kSlotMask] != -1) {
+				deadline = tick;
+				break;
+			}
+		}
+
+		unsigned long long deadlineMs = deadline * _tickMs;
+		if (deadlineMs <= nowMs) return 0;
+		return static_cast<int>(deadlineMs - nowMs);
+	}
+
+	void TimerWheel::expire(unsigned long long nowMs, std::vector<Expired>& expired) {
+		unsigned long long target = nowMs / _tickMs;
+		if (_count == 0) {
+			if (target > _current) _current = target;
+			return;
+		}
+
+		while (_current < target) {
+			++_current;
+			int index = static_cast<int>(_current & kSlotMask);
+			for (int level = 1; index == 0 && level < kLevels; ++level) {
+				index = static_cast<int>((_current >> (kSlotBits * level)) & kSlotMask);
+				cascade(level, index);
+			}
+
+			int slot = static_cast<int>(_current & kSlotMask);
+			while (_heads[0][slot] != -1) {
+				int fd = _heads[0][slot];
+				Expired entry = {fd, _nodes[fd].kind};
+				unlink(fd);
+				_nodes[fd].kind = 0;
+				_count--;
+				expired.push_back(entry);
+			}
+		}
+	}
+}  // namespace server
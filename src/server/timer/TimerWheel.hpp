@@ -0,0 +1,56 @@
+// TimerWheel.hpp
+#ifndef SERVER_TIMER_WHEEL_HPP
+#define SERVER_TIMER_WHEEL_HPP
+
+#include <vector>
+
+namespace server {
+	class TimerWheel {
+		public:
+			struct Expired {
+					int fd;
+					int kind;
+			};
+
+		private:
+			static const int kLevels = 4;
+			static const int kSlotBits = 6;
+			static const int kSlots = 1 << kSlotBits;
+			static const unsigned long long kSlotMask = kSlots - 1;
+
+			struct Node {
+					int prev;
+					int next;
+					int level;
+					int slot;
+					int kind;
+					unsigned long long expires;
+
+					Node() : prev(-1), next(-1), level(-1), slot(-1), kind(0), expires(0) {}
+			};
+
+			std::vector<Node> _nodes;
+			int _heads[kLevels][kSlots];
+			unsigned long long _current;
+			unsigned long _tickMs;
+			int _count;
+
+			bool isArmed(int) const;
+			void place(int);
+			void unlink(int);
+			void cascade(int, int);
+
+		public:
+			explicit TimerWheel(unsigned long);
+
+			static unsigned long long now();
+
+			void schedule(int, int, unsigned long, unsigned long long);
+			void cancel(int);
+			int kindOf(int) const;
+			int nextTimeout(unsigned long long) const;
+			void expire(unsigned long long, std::vector<Expired>&);
+	};
+}  // namespace server
+
+#endif
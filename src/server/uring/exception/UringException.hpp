@@ -0,0 +1,24 @@
+// UringException.hpp
+#ifndef SERVER_URING_EXCEPTION_HPP
+#define SERVER_URING_EXCEPTION_HPP
+
+#include <exception>
+#include <string>
+
+namespace server {
+	class UringException : public std::exception {
+		private:
+			std::string _message;
+
+		public:
+			explicit UringException(const std::string& message) :
+				_message("[Error] io_uring " + message + " Error") {}
+			virtual ~UringException() throw() {}
+
+			virtual const char* what() const throw() {
+				return _message.c_str();
+			}
+	};
+}  // namespace server
+
+#endif
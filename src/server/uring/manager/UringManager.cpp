@@ -0,0 +1,304 @@
+// UringManager.cpp
+#include "UringManager.hpp"
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "../exception/UringException.hpp"
+
+namespace server {
+	int UringManager::Completion::fd() const {
+		return static_cast<int>(data >> 16);
+	}
+
+	UringManager::Operation UringManager::Completion::operation() const {
+		return static_cast<Operation>((data >> 8) & 0xff);
+	}
+
+	int UringManager::Completion::step() const {
+		return static_cast<int>(data & 0xff);
+	}
+
+	bool UringManager::Completion::more() const {
+		return (flags & IORING_CQE_F_MORE) != 0;
+	}
+
+	bool UringManager::Completion::hasBuffer() const {
+		return (flags & IORING_CQE_F_BUFFER) != 0;
+	}
+
+	UringManager::UringManager() :
+		_ringFd(-1),
+		_sqRing(NULL),
+		_sqRingSize(0),
+		_cqRing(NULL),
+		_cqRingSize(0),
+		_sqes(NULL),
+		_sqesSize(0),
+		_sqHead(NULL),
+		_sqTail(NULL),
+		_sqFlags(NULL),
+		_sqArray(NULL),
+		_sqMask(0),
+		_sqEntries(0),
+		_cqHead(NULL),
+		_cqTail(NULL),
+		_cqMask(0),
+		_cqes(NULL),
+		_unsubmitted(0),
+		_bufferRing(NULL),
+		_bufferRingSize(0),
+		_bufferTail(0) {}
+
+	UringManager::~UringManager() {
+		if (_ringFd != -1) close(_ringFd);
+		if (_bufferRing) munmap(_bufferRing, _bufferRingSize);
+		if (_sqes) munmap(_sqes, _sqesSize);
+		if (_cqRing && _cqRing != _sqRing) munmap(_cqRing, _cqRingSize);
+		if (_sqRing) munmap(_sqRing, _sqRingSize);
+	}
+
+	uint64_t UringManager::tag(int fd, Operation operation, int step) {
+		return (static_cast<uint64_t>(fd) << 16) | (static_cast<uint64_t>(operation) << 8) |
+			   static_cast<uint64_t>(step & 0xff);
+	}
+
+	// False when the kernel cannot run this backend. SINGLE_ISSUER came with 6.0, as multishot
+	// recv did, so a ring that accepts it also has multishot accept and provided-buffer rings.
+	bool UringManager::init() {
+#ifdef IORING_SETUP_SINGLE_ISSUER
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN |
+					   IORING_SETUP_SINGLE_ISSUER;
+		params.cq_entries = kCompletions;
+		_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+		if (_ringFd == -1) return false;
+		if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+			return false;
+		return mapRings(params) && registerBuffers();
+#else
+		return false;
+#endif
+	}
+
+	bool UringManager::mapRings(const io_uring_params& params) {
+		_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (singleMmap) _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+		void* sq = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						_ringFd, IORING_OFF_SQ_RING);
+		if (sq == MAP_FAILED) return false;
+		_sqRing = static_cast<char*>(sq);
+
+		if (singleMmap) {
+			_cqRing = _sqRing;
+		} else {
+			void* cq = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+							_ringFd, IORING_OFF_CQ_RING);
+			if (cq == MAP_FAILED) return false;
+			_cqRing = static_cast<char*>(cq);
+		}
+
+		_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						  _ringFd, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) return false;
+		_sqes = static_cast<io_uring_sqe*>(sqes);
+
+		_sqHead = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.head);
+		_sqTail = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.tail);
+		_sqFlags = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.flags);
+		_sqArray = reinterpret_cast<unsigned*>(_sqRing + params.sq_off.array);
+		_sqMask = *reinterpret_cast<unsigned*>(_sqRing + params.sq_off.ring_mask);
+		_sqEntries = params.sq_entries;
+		_cqHead = reinterpret_cast<unsigned*>(_cqRing + params.cq_off.head);
+		_cqTail = reinterpret_cast<unsigned*>(_cqRing + params.cq_off.tail);
+		_cqMask = *reinterpret_cast<unsigned*>(_cqRing + params.cq_off.ring_mask);
+		_cqes = reinterpret_cast<io_uring_cqe*>(_cqRing + params.cq_off.cqes);
+		return true;
+	}
+
+	// Receive buffers live here and are handed to the kernel through a ring it picks them from;
+	// each one comes back with the recv completion that filled it and is returned by recycle().
+	bool UringManager::registerBuffers() {
+		_bufferRingSize = kBufferCount * sizeof(io_uring_buf);
+		void* ring = mmap(NULL, _bufferRingSize, PROT_READ | PROT_WRITE,
+						  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ring == MAP_FAILED) {
+			_bufferRing = NULL;
+			return false;
+		}
+		_bufferRing = static_cast<io_uring_buf*>(ring);
+
+		io_uring_buf_reg registration;
+		std::memset(&registration, 0, sizeof(registration));
+		registration.ring_addr = reinterpret_cast<uintptr_t>(ring);
+		registration.ring_entries = kBufferCount;
+		registration.bgid = kBufferGroup;
+		if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PBUF_RING, &registration,
+					1) != 0)
+			return false;
+
+		_buffers.resize(kBufferCount * kBufferSize);
+		for (unsigned i = 0; i < kBufferCount; ++i) provide(static_cast<unsigned short>(i));
+		return true;
+	}
+
+	// The ring's tail shares its first entry's resv field.
+	void UringManager::provide(unsigned short id) {
+		io_uring_buf& slot = _bufferRing[_bufferTail & (kBufferCount - 1)];
+		slot.addr = reinterpret_cast<uintptr_t>(&_buffers[id * kBufferSize]);
+		slot.len = static_cast<uint32_t>(kBufferSize);
+		slot.bid = id;
+		_bufferTail++;
+		__atomic_store_n(&_bufferRing[0].resv, _bufferTail, __ATOMIC_RELEASE);
+	}
+
+	int UringManager::enter(unsigned submit, unsigned minComplete, int timeout) {
+		io_uring_getevents_arg arg;
+		__kernel_timespec ts;
+		unsigned flags = 0;
+
+		std::memset(&arg, 0, sizeof(arg));
+		if (minComplete) {
+			flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+			if (timeout >= 0) {
+				ts.tv_sec = timeout / 1000;
+				ts.tv_nsec = static_cast<long long>(timeout % 1000) * 1000000;
+				arg.ts = reinterpret_cast<uintptr_t>(&ts);
+			}
+		} else if (__atomic_load_n(_sqFlags, __ATOMIC_RELAXED) &
+				   (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW)) {
+			flags = IORING_ENTER_GETEVENTS;
+		}
+		bool extended = flags & IORING_ENTER_EXT_ARG;
+		int ret = static_cast<int>(syscall(__NR_io_uring_enter, _ringFd, submit, minComplete, flags,
+										   extended ? &arg : NULL, extended ? sizeof(arg) : 0));
+		int saved = errno;
+		_unsubmitted = *_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+		errno = saved;
+		return ret;
+	}
+
+	// Makes room for a chain of count entries, so one is never split across two submissions.
+	void UringManager::reserve(unsigned count) {
+		if (_sqEntries - (*_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE)) >= count) return;
+		if (enter(_unsubmitted, 0, 0) == -1 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+			throw UringException("submit");
+		if (_sqEntries - (*_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE)) < count)
+			throw UringException("queue full");
+	}
+
+	io_uring_sqe* UringManager::prepare(unsigned char opcode, int fd, uint64_t data) {
+		reserve(1);
+		unsigned tail = *_sqTail;
+		unsigned index = tail & _sqMask;
+		io_uring_sqe* sqe = &_sqes[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = opcode;
+		sqe->fd = fd;
+		sqe->user_data = data;
+		_sqArray[index] = index;
+		__atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+		_unsubmitted++;
+		return sqe;
+	}
+
+	// Accepts keep coming until an error ends the request; like EPOLLEXCLUSIVE, a connection on
+	// a listener shared between workers wakes only one of their rings.
+	void UringManager::accept(int fd) {
+		io_uring_sqe* sqe = prepare(IORING_OP_ACCEPT, fd, tag(fd, AcceptOp, 0));
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	}
+
+	// A one-shot poll for a pending connection, completing as step 1 of AcceptOp. Out of
+	// descriptors, accept fails before it looks at the backlog, so it is only re-armed once
+	// there is a connection to refuse.
+	void UringManager::awaitClient(int fd) {
+		io_uring_sqe* sqe = prepare(IORING_OP_POLL_ADD, fd, tag(fd, AcceptOp, 1));
+		sqe->poll32_events = POLLIN;
+	}
+
+	void UringManager::receive(int fd) {
+		io_uring_sqe* sqe = prepare(IORING_OP_RECV, fd, tag(fd, ReceiveOp, 0));
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = kBufferGroup;
+	}
+
+	void UringManager::watch(int fd) {
+		io_uring_sqe* sqe = prepare(IORING_OP_POLL_ADD, fd, tag(fd, WatchOp, 0));
+		sqe->poll32_events = POLLIN;
+		sqe->len = IORING_POLL_ADD_MULTI;
+	}
+
+	void UringManager::cancel(int fd) {
+		io_uring_sqe* sqe = prepare(IORING_OP_ASYNC_CANCEL, fd, tag(fd, CancelOp, 0));
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	}
+
+	void UringManager::cancel(int fd, Operation operation) {
+		io_uring_sqe* sqe = prepare(IORING_OP_ASYNC_CANCEL, -1, tag(fd, CancelOp, 0));
+		sqe->addr = tag(fd, operation, 0);
+	}
+
+	// Submits everything queued since the last call and waits up to timeout ms (-1 for ever,
+	// 0 not at all) for a completion, all in one io_uring_enter. With nothing queued and no
+	// waiting asked for, the call is skipped.
+	void UringManager::wait(int timeout) {
+		bool pending = __atomic_load_n(_sqFlags, __ATOMIC_RELAXED) &
+					   (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW);
+		if (timeout != 0 || _unsubmitted > 0 || pending) {
+			if (enter(_unsubmitted, timeout != 0 ? 1 : 0, timeout) == -1 && errno != EINTR &&
+				errno != ETIME && errno != EBUSY && errno != EAGAIN)
+				throw UringException("enter");
+		}
+		reap();
+	}
+
+	void UringManager::reap() {
+		_completions.clear();
+		unsigned head = *_cqHead;
+		unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			const io_uring_cqe& cqe = _cqes[head & _cqMask];
+			Completion completion;
+			completion.data = cqe.user_data;
+			completion.result = cqe.res;
+			completion.flags = cqe.flags;
+			if (completion.operation() != CancelOp) _completions.push_back(completion);
+		}
+		__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	int UringManager::completionCount() const {
+		return static_cast<int>(_completions.size());
+	}
+
+	const UringManager::Completion& UringManager::completionAt(int index) const {
+		if (index < 0 || completionCount() <= index)
+			throw UringException("completions out of bounds");
+		return _completions[index];
+	}
+
+	const char* UringManager::buffer(const Completion& completion) const {
+		size_t id = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+		return &_buffers[id * kBufferSize];
+	}
+
+	void UringManager::recycle(const Completion& completion) {
+		if (completion.hasBuffer())
+			provide(static_cast<unsigned short>(completion.flags >> IORING_CQE_BUFFER_SHIFT));
+	}
+}  // namespace server
@@ -0,0 +1,107 @@
+// UringManager.hpp
+#ifndef SERVER_URING_MANAGER_HPP
+#define SERVER_URING_MANAGER_HPP
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "../../Defaults.hpp"
+
+namespace server {
+	// A completion-based ring for the event_backend io_uring mode: listeners take a multishot
+	// accept, clients a multishot recv into buffers the kernel picks from a provided-buffer
+	// ring, and output goes out as linked send/splice chains. Everything queued during a loop
+	// iteration is submitted by the one io_uring_enter in wait(), which also waits.
+	//
+	// Every request carries its fd, operation and step in user_data, so completions are
+	// routed without any per-request state here.
+	class UringManager {
+		public:
+			enum Operation {
+				AcceptOp = 1,
+				ReceiveOp,
+				SendOp,
+				WatchOp,
+				CancelOp
+			};
+
+			struct Completion {
+					uint64_t data;
+					int result;
+					unsigned int flags;
+
+					int fd() const;
+					Operation operation() const;
+					int step() const;
+					bool more() const;
+					bool hasBuffer() const;
+			};
+
+		private:
+			static const unsigned kEntries = defaults::URING_QUEUE_SIZE;
+			static const unsigned kCompletions = defaults::URING_COMPLETION_SIZE;
+			static const unsigned kBufferCount = defaults::URING_BUFFER_COUNT;
+			static const size_t kBufferSize = defaults::URING_BUFFER_SIZE;
+			static const unsigned short kBufferGroup = 0;
+
+			int _ringFd;
+			char* _sqRing;
+			size_t _sqRingSize;
+			char* _cqRing;
+			size_t _cqRingSize;
+			io_uring_sqe* _sqes;
+			size_t _sqesSize;
+			unsigned* _sqHead;
+			unsigned* _sqTail;
+			unsigned* _sqFlags;
+			unsigned* _sqArray;
+			unsigned _sqMask;
+			unsigned _sqEntries;
+			unsigned* _cqHead;
+			unsigned* _cqTail;
+			unsigned _cqMask;
+			io_uring_cqe* _cqes;
+			unsigned _unsubmitted;
+			io_uring_buf* _bufferRing;
+			size_t _bufferRingSize;
+			unsigned short _bufferTail;
+			std::vector<char> _buffers;
+			std::vector<Completion> _completions;
+
+			UringManager(const UringManager&);
+			UringManager& operator=(const UringManager&);
+
+			bool mapRings(const io_uring_params&);
+			bool registerBuffers();
+			void provide(unsigned short);
+			int enter(unsigned, unsigned, int);
+			void reap();
+
+		public:
+			UringManager();
+			~UringManager();
+
+			static uint64_t tag(int, Operation, int);
+
+			bool init();
+			void reserve(unsigned);
+			io_uring_sqe* prepare(unsigned char, int, uint64_t);
+			void accept(int);
+			void awaitClient(int);
+			void receive(int);
+			void watch(int);
+			void cancel(int);
+			void cancel(int, Operation);
+			void wait(int);
+
+			int completionCount() const;
+			const Completion& completionAt(int) const;
+			const char* buffer(const Completion&) const;
+			void recycle(const Completion&);
+	};
+}  // namespace server
+
+#endif
@@ -6,6 +6,8 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <cerrno>
+
 #include "../exception/Exception.hpp"
 
 namespace server {
@@ -24,9 +26,25 @@ namespace server {
 			if (::listen(fd, backlog) < 0) throw Exception("listen");
 		}
 
-		inline int accept(int fd, sockaddr* address, socklen_t* addressLen) {
-			int client = ::accept(fd, address, addressLen);
-			if (client < 0) throw Exception("accept");
+		// Returns -1 with errno intact for conditions the accept loop recovers from.
+		inline int accept(int fd, sockaddr* address, socklen_t* addressLen, int flags) {
+			int client = ::accept4(fd, address, addressLen, flags);
+			if (client < 0) {
+				switch (errno) {
+					case EAGAIN:
+					case EINTR:
+					case ECONNABORTED:
+					case EPROTO:
+					case EPERM:
+					case EMFILE:
+					case ENFILE:
+					case ENOBUFS:
+					case ENOMEM:
+						return -1;
+					default:
+						throw Exception("accept");
+				}
+			}
 			return client;
 		}
 
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Minimal FastCGI responder standing in for fcgiwrap.
+
+Every request runs the script named by SCRIPT_FILENAME as a CGI program: it is executed
+directly (so it needs its shebang and execute bit), gets the request's PARAMS as its
+environment and its STDIN records as stdin, and what it prints goes back as STDOUT.
+Requests on one connection run concurrently unless --single is given, in which case the
+responder answers FCGI_MPXS_CONNS=0 and the server uses one connection per request.
+
+What happens is logged one event per line on stdout, for the tests to check:
+    connection
+    begin <id>
+    abort <id>
+    end <id> <exit status>
+
+    python3 tests/fastcgi/responder.py /tmp/webserv-fcgi.sock [--single]
+"""
+import os
+import socket
+import struct
+import subprocess
+import sys
+import threading
+
+VERSION = 1
+BEGIN_REQUEST = 1
+ABORT_REQUEST = 2
+END_REQUEST = 3
+PARAMS = 4
+STDIN = 5
+STDOUT = 6
+GET_VALUES = 9
+GET_VALUES_RESULT = 10
+REQUEST_COMPLETE = 0
+
+HEADER = struct.Struct(">BBHHBx")
+MAX_CONTENT = 0xFFFF
+
+log_lock = threading.Lock()
+
+
+def log(*words):
+    with log_lock:
+        print(*words, flush=True)
+
+
+def record(kind, request_id, content=b""):
+    padding = -len(content) % 8
+    return HEADER.pack(VERSION, kind, request_id, len(content), padding) + content + b"\0" * padding
+
+
+def read_length(data, offset):
+    if data[offset] & 0x80:
+        return struct.unpack_from(">I", data, offset)[0] & 0x7FFFFFFF, offset + 4
+    return data[offset], offset + 1
+
+
+def decode_pairs(data):
+    pairs = {}
+    offset = 0
+    while offset < len(data):
+        name_length, offset = read_length(data, offset)
+        value_length, offset = read_length(data, offset)
+        name = data[offset:offset + name_length].decode("latin-1")
+        offset += name_length
+        pairs[name] = data[offset:offset + value_length].decode("latin-1")
+        offset += value_length
+    return pairs
+
+
+def encode_pair(name, value):
+    name, value = name.encode(), value.encode()
+    return bytes([len(name), len(value)]) + name + value
+
+
+class Request:
+    def __init__(self, connection, request_id):
+        self.connection = connection
+        self.id = request_id
+        self.params = b""
+        self.process = None
+        self.aborted = False
+        self.lock = threading.Lock()
+
+    def start(self):
+        environ = decode_pairs(self.params)
+        try:
+            self.process = subprocess.Popen([environ.get("SCRIPT_FILENAME", "")], env=environ,
+                                            cwd=os.path.dirname(environ.get("SCRIPT_FILENAME", "/")),
+                                            stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        except OSError:
+            self.connection.send(record(STDOUT, self.id,
+                                        b"Status: 404 Not Found\r\nContent-Type: text/plain\r\n\r\n"))
+            self.finish(127)
+            return
+        threading.Thread(target=self.relay, daemon=True).start()
+
+    def write(self, data):
+        with self.lock:
+            if not self.process or self.aborted:
+                return
+            try:
+                if data:
+                    self.process.stdin.write(data)
+                    self.process.stdin.flush()
+                else:
+                    self.process.stdin.close()
+            except OSError:
+                pass
+
+    def relay(self):
+        while True:
+            data = self.process.stdout.read1(MAX_CONTENT)
+            if not data:
+                break
+            if not self.aborted:
+                self.connection.send(record(STDOUT, self.id, data))
+        self.finish(self.process.wait())
+
+    def abort(self):
+        log("abort", self.id)
+        with self.lock:
+            self.aborted = True
+            if self.process:
+                self.process.kill()
+
+    def finish(self, status):
+        log("end", self.id, status)
+        body = struct.pack(">IB3x", status & 0xFFFFFFFF, REQUEST_COMPLETE)
+        self.connection.send(record(STDOUT, self.id) + record(END_REQUEST, self.id, body))
+        self.connection.forget(self.id)
+
+
+class Connection:
+    def __init__(self, sock, multiplexed):
+        self.sock = sock
+        self.multiplexed = multiplexed
+        self.requests = {}
+        self.lock = threading.Lock()
+
+    def send(self, data):
+        with self.lock:
+            try:
+                self.sock.sendall(data)
+            except OSError:
+                pass
+
+    def forget(self, request_id):
+        with self.lock:
+            self.requests.pop(request_id, None)
+
+    def serve(self):
+        log("connection")
+        buffered = b""
+        while True:
+            try:
+                data = self.sock.recv(65536)
+            except OSError:
+                data = b""
+            if not data:
+                break
+            buffered += data
+            while len(buffered) >= HEADER.size:
+                _, kind, request_id, length, padding = HEADER.unpack_from(buffered)
+                if len(buffered) < HEADER.size + length + padding:
+                    break
+                content = buffered[HEADER.size:HEADER.size + length]
+                buffered = buffered[HEADER.size + length + padding:]
+                self.handle(kind, request_id, content)
+        for request in list(self.requests.values()):
+            request.abort()
+        self.sock.close()
+
+    def handle(self, kind, request_id, content):
+        request = self.requests.get(request_id)
+        if kind == GET_VALUES:
+            values = encode_pair("FCGI_MPXS_CONNS", "1" if self.multiplexed else "0")
+            values += encode_pair("FCGI_MAX_REQS", "16")
+            self.send(record(GET_VALUES_RESULT, 0, values))
+        elif kind == BEGIN_REQUEST:
+            log("begin", request_id)
+            with self.lock:
+                self.requests[request_id] = Request(self, request_id)
+        elif kind == PARAMS and request:
+            if content:
+                request.params += content
+            else:
+                request.start()
+        elif kind == STDIN and request:
+            request.write(content)
+        elif kind == ABORT_REQUEST and request:
+            request.abort()
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: responder.py SOCKET [--single]")
+    path = sys.argv[1]
+    multiplexed = "--single" not in sys.argv[2:]
+    try:
+        os.unlink(path)
+    except FileNotFoundError:
+        pass
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(path)
+    server.listen(64)
+    while True:
+        sock, _ = server.accept()
+        connection = Connection(sock, multiplexed)
+        threading.Thread(target=connection.serve, daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
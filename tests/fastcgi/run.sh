@@ -0,0 +1,94 @@
+#!/bin/bash
+# Runs webserv against tests/fastcgi/responder.py: the cgi-bin scripts behind the wrapper,
+# requests multiplexed on one connection (and one connection each with --single),
+# ABORT_REQUEST when a client goes away mid-response, 502 when the backend is down or a
+# request ends without output, and a closed connection when the backend drops mid-body.
+# Expects ./webserv to be built; run from anywhere.
+
+cd "$(dirname "$0")/../.." || exit 1
+
+URL=http://127.0.0.1:8090
+SOCKET=/tmp/webserv-test-fcgi.sock
+SINGLE_SOCKET=/tmp/webserv-test-fcgi-single.sock
+LOGS=$(mktemp -d)
+PIDS=()
+FAILED=0
+
+cleanup() {
+	kill "${PIDS[@]}" 2>/dev/null
+	wait 2>/dev/null
+	rm -rf "$LOGS" "$SOCKET" "$SINGLE_SOCKET"
+}
+trap cleanup EXIT
+
+check() {
+	if [ "$2" == "$3" ]; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1: expected $2, got $3"
+		FAILED=1
+	fi
+}
+
+wait_for() {
+	for _ in $(seq 50); do
+		eval "$1" && return 0
+		sleep 0.1
+	done
+	return 1
+}
+
+python3 tests/fastcgi/responder.py "$SOCKET" > "$LOGS/multiplexed.log" &
+PIDS+=($!)
+# Its scripts outlive it when it is killed at the end, and complain about the closed pipe.
+python3 tests/fastcgi/responder.py "$SINGLE_SOCKET" --single > "$LOGS/single.log" \
+	2> "$LOGS/single.err" &
+PIDS+=($!)
+./webserv tests/fastcgi/fastcgi.conf > "$LOGS/webserv.log" 2>&1 &
+PIDS+=($!)
+wait_for "[ -S $SOCKET ] && [ -S $SINGLE_SOCKET ] && curl -s -o /dev/null $URL/" ||
+	{ echo "FAIL could not start webserv or the responders"; exit 1; }
+
+status() {
+	curl -s -o /dev/null -w '%{http_code}' "$@"
+}
+
+# Runs four slow requests at once after a first one has opened the connection; prints how
+# many connections the responder saw and whether the four overlapped.
+concurrent() {
+	status "$URL/$1/slow.py" > /dev/null
+	local start=$(date +%s%N)
+	for i in 1 2 3 4; do status "$URL/$1/slow.py" > /dev/null & done
+	wait
+	local elapsed=$((($(date +%s%N) - start) / 1000000))
+	echo "$(grep -c '^connection' "$2") $([ $elapsed -lt 1800 ] && echo parallel || echo serial)"
+}
+
+check "cgi-bin script behind the wrapper" 200 "$(status "$URL/fcgi-bin/list_files.py")"
+check "cgi-bin script sees its method" 405 "$(status -X POST "$URL/fcgi-bin/list_files.py")"
+
+check "MPXS_CONNS=1 shares one connection" "1 parallel" "$(concurrent fcgi "$LOGS/multiplexed.log")"
+check "MPXS_CONNS=0 opens one per request" "4 parallel" "$(concurrent single "$LOGS/single.log")"
+
+curl -s -m 0.5 -o /dev/null "$URL/fcgi/tick.py"
+wait_for "grep -q '^abort' $LOGS/multiplexed.log"
+check "client drop sends ABORT_REQUEST" 1 "$(grep -c '^abort' "$LOGS/multiplexed.log")"
+check "connection survives the abort" 200 "$(status "$URL/fcgi/slow.py")"
+check "no new connection after the abort" 1 "$(grep -c '^connection' "$LOGS/multiplexed.log")"
+
+check "unreachable backend" 502 "$(status "$URL/down/slow.py")"
+check "request ended without output" 502 "$(status "$URL/fcgi/silent.py")"
+
+# The single-request responder is killed while one request waits for its head and another is
+# halfway through its body; curl exits 18 when a chunked body is cut short.
+status "$URL/single/slow.py" > "$LOGS/before-head" &
+BEFORE_HEAD=$!
+{ curl -s -o /dev/null "$URL/single/tick.py"; echo $? > "$LOGS/mid-body"; } &
+MID_BODY=$!
+sleep 0.5
+kill "${PIDS[1]}"
+wait $BEFORE_HEAD $MID_BODY
+check "backend dropped before the head" 502 "$(cat "$LOGS/before-head")"
+check "backend dropped mid-body" 18 "$(cat "$LOGS/mid-body")"
+
+exit $FAILED
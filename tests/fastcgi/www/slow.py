@@ -0,0 +1,8 @@
+#!/usr/bin/env python3
+import time
+
+time.sleep(1)
+print("Status: 200 OK\r")
+print("Content-Type: text/plain\r")
+print("\r")
+print("slow")
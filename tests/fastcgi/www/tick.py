@@ -0,0 +1,9 @@
+#!/usr/bin/env python3
+import sys
+import time
+
+sys.stdout.write("Status: 200 OK\r\nContent-Type: text/plain\r\n\r\n")
+for i in range(50):
+    sys.stdout.write("tick %d\n" % i)
+    sys.stdout.flush()
+    time.sleep(0.1)
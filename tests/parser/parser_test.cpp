@@ -0,0 +1,257 @@
+// parser_test.cpp
+// http::Parser fed the way Connection feeds it: bytes land through writable()/commit() in
+// whatever pieces the socket returned, and parse() runs after each one.
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../src/http/parser/BufferPool.hpp"
+#include "../../src/http/parser/Parser.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const std::string& name) {
+		if (!condition) {
+			std::cout << "FAIL " << name << std::endl;
+			failures++;
+		}
+	}
+
+	void feed(http::Parser& parser, const std::string& data) {
+		size_t available = 0;
+		char* buffer = parser.writable(data.size(), available);
+		std::memcpy(buffer, data.data(), data.size());
+		parser.commit(data.size());
+	}
+
+	// Feeds `data` in pieces of `step` bytes; every piece but the last must leave the request
+	// incomplete.
+	http::Parser::Result feedInPieces(http::Parser& parser, const std::string& data, size_t step,
+									  const std::string& name) {
+		http::Parser::Result result;
+		for (size_t offset = 0; offset < data.size(); offset += step) {
+			feed(parser, data.substr(offset, step));
+			result = parser.parse();
+			if (offset + step < data.size())
+				check(result.status == http::Parser::Result::Incomplete,
+					  name + ": complete before its last byte");
+		}
+		return result;
+	}
+
+	std::string bodyOf(const http::Packet& packet) {
+		const http::Body& body = packet.getBody();
+		if (!body.isFileBacked()) {
+			const std::vector<unsigned char>& data = body.getData();
+			return std::string(data.begin(), data.end());
+		}
+		const http::FileRegion& file = body.getFile();
+		std::string content(file.getLength(), '\0');
+		ssize_t got = pread(file.getFd(), &content[0], content.size(), file.getOffset());
+		content.resize(got > 0 ? static_cast<size_t>(got) : 0);
+		return content;
+	}
+
+	http::Parser* newParser(http::BufferPool* pool) {
+		http::Parser* parser = new http::Parser();
+		parser->setBufferPool(pool);
+		parser->setMaxBodySize(1024 * 1024);
+		parser->setBodyBufferSize(16 * 1024);
+		return parser;
+	}
+
+	void testPipelined() {
+		http::Parser parser;
+		feed(parser,
+			 "GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+			 "POST /b HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n\r\nabc"
+			 "GET /c HTTP/1.1\r\nHost: x\r\n\r\n");
+		const char* targets[] = {"/a", "/b", "/c"};
+		for (int i = 0; i < 3; ++i) {
+			http::Parser::Result result = parser.parse();
+			check(result.status == http::Parser::Result::Completed, "pipelined: request completes");
+			check(result.packet.getStartLine().target == targets[i], "pipelined: target in order");
+			if (i == 1) check(bodyOf(result.packet) == "abc", "pipelined: body kept apart");
+		}
+		check(!parser.hasPendingInput(), "pipelined: nothing left over");
+	}
+
+	void testSplitHead() {
+		const std::string request =
+			"GET /split?q=1 HTTP/1.1\r\nHost: example.com\r\nX-Long: a b c\r\n\r\n";
+		for (size_t step = 1; step <= 7; step += 3) {
+			http::Parser parser;
+			http::Parser::Result result = feedInPieces(parser, request, step, "split head");
+			check(result.status == http::Parser::Result::Completed, "split head: completes");
+			check(result.packet.getStartLine().target == "/split?q=1", "split head: target");
+			check(result.packet.getStartLine().version == "HTTP/1.1", "split head: version");
+			check(result.packet.getHeader().get("Host") == "example.com", "split head: header");
+			check(result.packet.getHeader().get("X-Long") == "a b c", "split head: value");
+		}
+	}
+
+	void testChunked() {
+		const std::string request =
+			"POST /c HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"
+			"4\r\nWiki\r\n5;ext=1\r\npedia\r\n10\r\n0123456789abcdef\r\n0\r\n\r\n";
+		const std::string expected = "Wikipedia0123456789abcdef";
+
+		http::Parser whole;
+		feed(whole, request);
+		http::Parser::Result result = whole.parse();
+		check(result.status == http::Parser::Result::Completed, "chunked: completes");
+		check(bodyOf(result.packet) == expected, "chunked: body");
+
+		// One byte at a time splits every chunk size line, "10" included, and every delimiter.
+		http::Parser split;
+		result = feedInPieces(split, request, 1, "chunked split");
+		check(result.status == http::Parser::Result::Completed, "chunked split: completes");
+		check(bodyOf(result.packet) == expected, "chunked split: body");
+
+		http::Parser bad;
+		feed(bad, "POST /c HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n");
+		check(bad.parse().status == http::Parser::Result::Error, "chunked: bad size rejected");
+	}
+
+	void testLimits() {
+		http::Parser declared;
+		declared.setMaxBodySize(8);
+		feed(declared, "POST / HTTP/1.1\r\nHost: x\r\nContent-Length: 9\r\n\r\n");
+		http::Parser::Result result = declared.parse();
+		check(result.status == http::Parser::Result::Error &&
+				  result.errorCode == http::StatusCode::RequestEntityTooLarge,
+			  "limits: Content-Length over client_max_body_size");
+
+		http::Parser chunked;
+		chunked.setMaxBodySize(8);
+		feed(chunked, "POST / HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"
+					  "5\r\n12345\r\n4\r\n6789\r\n");
+		result = chunked.parse();
+		check(result.status == http::Parser::Result::Error &&
+				  result.errorCode == http::StatusCode::RequestEntityTooLarge,
+			  "limits: chunks adding up past client_max_body_size");
+
+		http::Parser atLimit;
+		atLimit.setMaxBodySize(8);
+		feed(atLimit, "POST / HTTP/1.1\r\nHost: x\r\nContent-Length: 8\r\n\r\n12345678");
+		check(atLimit.parse().status == http::Parser::Result::Completed,
+			  "limits: body of exactly client_max_body_size");
+
+		// A head that never ends is refused once it outgrows the limit, not buffered on.
+		http::Parser endless;
+		feed(endless, "GET / HTTP/1.1\r\nHost: x\r\n");
+		result = endless.parse();
+		std::string field = "X-Filler: " + std::string(1000, 'a') + "\r\n";
+		for (int i = 0; i < 64 && result.status == http::Parser::Result::Incomplete; ++i) {
+			feed(endless, field);
+			result = endless.parse();
+		}
+		check(result.status == http::Parser::Result::Error &&
+				  result.errorCode == http::StatusCode::RequestHeaderFieldsTooLarge,
+			  "limits: unterminated head over the header limit");
+
+		http::Parser whole;
+		std::string head = "GET / HTTP/1.1\r\nHost: x\r\n";
+		for (int i = 0; i < 40; ++i) head += field;
+		feed(whole, head + "\r\n");
+		result = whole.parse();
+		check(result.status == http::Parser::Result::Error &&
+				  result.errorCode == http::StatusCode::RequestHeaderFieldsTooLarge,
+			  "limits: complete head over the header limit");
+
+		http::Parser fits;
+		head = "GET / HTTP/1.1\r\nHost: x\r\n";
+		for (int i = 0; i < 16; ++i) head += field;
+		feed(fits, head + "\r\n");
+		check(fits.parse().status == http::Parser::Result::Completed,
+			  "limits: head under the header limit");
+	}
+
+	void testSpool() {
+		char directory[] = "/tmp/webserv-parser-test-XXXXXX";
+		check(mkdtemp(directory) != NULL, "spool: temp directory");
+
+		std::string body;
+		for (int i = 0; i < 2000; ++i) body += static_cast<char>('a' + i % 26);
+		const std::string head = "POST /up HTTP/1.1\r\nHost: x\r\nContent-Length: 2000\r\n\r\n";
+
+		http::Parser parser;
+		parser.setMaxBodySize(4096);
+		parser.setBodyBufferSize(512);
+		parser.setBodyTempPath(directory);
+		http::Parser::Result result = feedInPieces(parser, head + body, 300, "spool");
+		check(result.status == http::Parser::Result::Completed, "spool: completes");
+		check(result.packet.getBody().isFileBacked(), "spool: body moved to a file");
+		check(bodyOf(result.packet) == body, "spool: file holds the whole body");
+
+		http::Parser small;
+		small.setMaxBodySize(4096);
+		small.setBodyBufferSize(4096);
+		small.setBodyTempPath(directory);
+		feed(small, head + body);
+		result = small.parse();
+		check(!result.packet.getBody().isFileBacked(), "spool: body within the buffer stays");
+		check(bodyOf(result.packet) == body, "spool: buffered body");
+
+		// The spooled file is unlinked at once; only the directory is left to clean up.
+		check(rmdir(directory) == 0, "spool: temp file unlinked");
+	}
+
+	void testBufferPool() {
+		http::BufferPool pool;
+		http::Parser* first = newParser(&pool);
+		size_t available = 0;
+		char* block = first->writable(1, available);
+		feed(*first, "GET / HTTP/1.1\r\nHost: x\r\n\r\n");
+		check(first->parse().status == http::Parser::Result::Completed, "pool: request");
+
+		// Nothing is buffered after the request, so the block went back and is handed out next.
+		http::Parser* second = newParser(&pool);
+		check(second->writable(1, available) == block, "pool: finished request frees its block");
+
+		// A read that got nothing leaves the block idle too.
+		first->writable(1, available);
+		first->commit(0);
+		first->releaseIdleBuffer();
+		char* idle = pool.acquire(http::BufferPool::blockSize(available));
+		check(idle != block, "pool: distinct blocks");
+		pool.release(idle, http::BufferPool::blockSize(available));
+		http::Parser* third = newParser(&pool);
+		check(third->writable(1, available) == idle, "pool: idle block returned after empty read");
+
+		// A pipelined request left behind keeps the block.
+		feed(*second, "GET /a HTTP/1.1\r\nHost: x\r\n\r\nGET /b");
+		check(second->parse().status == http::Parser::Result::Completed, "pool: first of two");
+		second->releaseIdleBuffer();
+		check(second->hasPendingInput(), "pool: partial request kept");
+		feed(*second, " HTTP/1.1\r\nHost: x\r\n\r\n");
+		http::Parser::Result result = second->parse();
+		check(result.status == http::Parser::Result::Completed &&
+				  result.packet.getStartLine().target == "/b",
+			  "pool: partial request completes");
+
+		delete first;
+		delete second;
+		delete third;
+	}
+}
+
+int main() {
+	testPipelined();
+	testSplitHead();
+	testChunked();
+	testLimits();
+	testSpool();
+	testBufferPool();
+	if (failures) {
+		std::cout << failures << " parser check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "ok   parser" << std::endl;
+	return EXIT_SUCCESS;
+}
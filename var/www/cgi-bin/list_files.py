@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 import os
 import json
+import sys
 import time
 
 UPLOAD_DIR = os.environ.get('UPLOAD_PATH') or './var/www/uploads'